@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "vkdd.hpp"
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+#include "command_execution_unit.hpp"
+#include "logical_device.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// measures recording and submitting a frame through a command execution unit for 1 to 32 recording threads
+// every thread records pairs of empty command buffers: a transfer command buffer, which signals the thread's timeline
+// semaphore, and a graphics command buffer, which waits for it. so each pair goes through requestCommandBuffer(),
+// pushSignal() and pushWait(). the main thread calls submit() once all threads are done
+// recording is the time from releasing the threads until the last of them finished, submit is the time of submit()
+// the units compared are
+//   single mutex     the unit before the recording slots, every request and push locks the unit's mutex and looks up
+//                    the command buffer and the calling thread's command pool in hash maps
+//   recording slots  the app's unit, every thread binds its own slot and doesn't lock at all
+// the benchmark runs on the first device group without opening a display, it needs a GPU with two transfer queue
+// families like the app
+
+namespace vkdd {
+typedef std::chrono::steady_clock Clock;
+
+static constexpr uint32_t NUM_WARMUP_FRAMES     = 20;
+static constexpr uint32_t NUM_FRAMES            = 200;
+static constexpr uint32_t NUM_PAIRS_PER_THREAD  = 16;
+static constexpr uint32_t MAX_RECORDING_THREADS = 32;
+
+struct Percentiles
+{
+  double m_median;
+  double m_p99;
+};
+
+static Percentiles getPercentiles(std::vector<double>& micros)
+{
+  std::sort(micros.begin(), micros.end());
+  return {micros[micros.size() / 2], micros[micros.size() * 99 / 100]};
+}
+
+// the command execution unit before the recording slots, reduced to the calls of the benchmark
+class SingleMutexCommandExecutionUnit
+{
+public:
+  SingleMutexCommandExecutionUnit(LogicalDevice& logicalDevice)
+      : m_logicalDevice(logicalDevice)
+  {
+  }
+
+  void waitForIdle()
+  {
+    std::vector<vk::Fence> fences;
+    for(auto const& it : m_library)
+    {
+      fences.emplace_back(it.second.m_syncFence.get());
+    }
+    if(!m_submitted || fences.empty())
+    {
+      return;
+    }
+    (void)m_logicalDevice.vkDevice().waitForFences(fences, true, std::numeric_limits<uint64_t>::max());
+    m_logicalDevice.vkDevice().resetFences(fences);
+    m_submitted = false;
+  }
+
+  void waitForIdleAndReset()
+  {
+    this->waitForIdle();
+    for(auto& queueIt : m_library)
+    {
+      for(auto& threadIt : queueIt.second.m_perThreadCommandBufferPools)
+      {
+        m_logicalDevice.vkDevice().resetCommandPool(threadIt.second.m_commandPool.get());
+        threadIt.second.m_nextCommandBufferIndex = 0;
+      }
+    }
+  }
+
+  vk::CommandBuffer requestCommandBuffer(uint32_t queueFamilyIndex)
+  {
+    std::lock_guard    guard(m_mutex);
+    QueueFamilyData&   queueData = m_library[queueFamilyIndex];
+    CommandBufferPool& cbp       = queueData.m_perThreadCommandBufferPools[std::this_thread::get_id()];
+    if(!queueData.m_syncFence)
+    {
+      queueData.m_syncFence = m_logicalDevice.vkDevice().createFenceUnique({});
+    }
+    if(!cbp.m_commandPool)
+    {
+      cbp.m_commandPool = m_logicalDevice.vkDevice().createCommandPoolUnique({{}, queueFamilyIndex});
+    }
+    if(cbp.m_commandBuffers.size() <= cbp.m_nextCommandBufferIndex)
+    {
+      vk::CommandBufferAllocateInfo allocateInfo(cbp.m_commandPool.get(), vk::CommandBufferLevel::ePrimary, 1);
+      cbp.m_commandBuffers.emplace_back(std::move(m_logicalDevice.vkDevice().allocateCommandBuffersUnique(allocateInfo)[0]));
+    }
+    vk::CommandBuffer cmdBuffer     = cbp.m_commandBuffers[cbp.m_nextCommandBufferIndex++].get();
+    m_commandBufferInfos[cmdBuffer] = {{cmdBuffer}, {}, {}};
+    m_submitOrder[queueFamilyIndex].emplace_back(cmdBuffer);
+    return cmdBuffer;
+  }
+
+  void pushWait(vk::CommandBuffer cmdBuffer, vk::SemaphoreSubmitInfo waitSemaphoreInfo)
+  {
+    std::lock_guard guard(m_mutex);
+    auto            findIt = m_commandBufferInfos.find(cmdBuffer);
+    if(findIt == m_commandBufferInfos.end())
+    {
+      LOGE("Unknown command buffer given.\n");
+      return;
+    }
+    findIt->second.m_waitSemaphoreInfos.emplace_back(waitSemaphoreInfo);
+  }
+
+  void pushSignal(vk::CommandBuffer cmdBuffer, vk::SemaphoreSubmitInfo signalSemaphoreInfo)
+  {
+    std::lock_guard guard(m_mutex);
+    auto            findIt = m_commandBufferInfos.find(cmdBuffer);
+    if(findIt == m_commandBufferInfos.end())
+    {
+      LOGE("Unknown command buffer given.\n");
+      return;
+    }
+    findIt->second.m_signalSemaphoreInfos.emplace_back(signalSemaphoreInfo);
+  }
+
+  void submit()
+  {
+    for(auto const& it : m_submitOrder)
+    {
+      std::vector<vk::SubmitInfo2> submits;
+      for(vk::CommandBuffer cmdBuffer : it.second)
+      {
+        CommandBufferInfo const& info = m_commandBufferInfos[cmdBuffer];
+        submits.emplace_back(vk::SubmitInfo2({}, info.m_waitSemaphoreInfos, info.m_commandBufferInfo, info.m_signalSemaphoreInfos));
+      }
+      m_logicalDevice.getQueue(it.first).submit2(submits, m_library[it.first].m_syncFence.get());
+    }
+    m_submitted = !m_submitOrder.empty();
+    m_submitOrder.clear();
+    m_commandBufferInfos.clear();
+  }
+
+private:
+  struct CommandBufferPool
+  {
+    vk::UniqueCommandPool                m_commandPool;
+    std::vector<vk::UniqueCommandBuffer> m_commandBuffers;
+    uint32_t                             m_nextCommandBufferIndex = 0;
+  };
+
+  struct QueueFamilyData
+  {
+    vk::UniqueFence                                        m_syncFence;
+    std::unordered_map<std::thread::id, CommandBufferPool> m_perThreadCommandBufferPools;
+  };
+
+  struct CommandBufferInfo
+  {
+    vk::CommandBufferSubmitInfo          m_commandBufferInfo;
+    std::vector<vk::SemaphoreSubmitInfo> m_waitSemaphoreInfos;
+    std::vector<vk::SemaphoreSubmitInfo> m_signalSemaphoreInfos;
+  };
+
+  LogicalDevice&                                               m_logicalDevice;
+  std::mutex                                                   m_mutex;
+  std::unordered_map<uint32_t, QueueFamilyData>                m_library;
+  std::unordered_map<VkCommandBuffer, CommandBufferInfo>       m_commandBufferInfos;
+  std::unordered_map<uint32_t, std::vector<vk::CommandBuffer>> m_submitOrder;
+  bool                                                         m_submitted = false;
+};
+
+// the timeline semaphore of a recording thread and the last value it signaled, the values keep increasing across the
+// frames of both units
+struct RecordingThreadSemaphore
+{
+  vk::UniqueSemaphore m_semaphore;
+  uint64_t            m_value;
+};
+
+template <typename Unit>
+static void recordPairs(Unit& unit, LogicalDevice const& logicalDevice, RecordingThreadSemaphore& sem)
+{
+  vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  for(uint32_t i = 0; i < NUM_PAIRS_PER_THREAD; ++i)
+  {
+    vk::CommandBuffer transferCmdBuffer = unit.requestCommandBuffer(logicalDevice.getTransferQueueFamilyIndex());
+    transferCmdBuffer.begin(beginInfo);
+    transferCmdBuffer.end();
+    unit.pushSignal(transferCmdBuffer, {sem.m_semaphore.get(), ++sem.m_value, vk::PipelineStageFlagBits2::eAllCommands});
+    vk::CommandBuffer graphicsCmdBuffer = unit.requestCommandBuffer(logicalDevice.getGraphicsQueueFamilyIndex());
+    graphicsCmdBuffer.begin(beginInfo);
+    graphicsCmdBuffer.end();
+    unit.pushWait(graphicsCmdBuffer, {sem.m_semaphore.get(), sem.m_value, vk::PipelineStageFlagBits2::eAllCommands});
+  }
+}
+
+// the recording threads live for all frames, like the app's threads, bindThread is called once on each of them and
+// reset before each frame
+template <typename Unit>
+static void measureFrames(char const*                            unitName,
+                          Unit&                                  unit,
+                          LogicalDevice&                         logicalDevice,
+                          std::vector<RecordingThreadSemaphore>& semaphores,
+                          uint32_t                               numThreads,
+                          std::function<void(uint32_t)> const&   bindThread,
+                          std::function<void()> const&           reset)
+{
+  std::atomic<uint32_t>          numReleasedFrames(0);
+  std::atomic<uint32_t>          numFinishedThreads(0);
+  std::vector<Clock::time_point> finishes(numThreads);
+  std::vector<std::thread>       threads;
+  for(uint32_t i = 0; i < numThreads; ++i)
+  {
+    threads.emplace_back([&, i]() {
+      bindThread(i);
+      for(uint32_t frame = 0; frame < NUM_WARMUP_FRAMES + NUM_FRAMES; ++frame)
+      {
+        while(numReleasedFrames.load(std::memory_order_acquire) <= frame)
+        {
+          std::this_thread::yield();
+        }
+        recordPairs(unit, logicalDevice, semaphores[i]);
+        finishes[i] = Clock::now();
+        numFinishedThreads.fetch_add(1, std::memory_order_release);
+      }
+    });
+  }
+  std::vector<double> recordingMicros;
+  std::vector<double> submitMicros;
+  for(uint32_t frame = 0; frame < NUM_WARMUP_FRAMES + NUM_FRAMES; ++frame)
+  {
+    reset();
+    numFinishedThreads.store(0, std::memory_order_relaxed);
+    Clock::time_point release = Clock::now();
+    numReleasedFrames.store(frame + 1, std::memory_order_release);
+    while(numFinishedThreads.load(std::memory_order_acquire) < numThreads)
+    {
+      std::this_thread::yield();
+    }
+    Clock::time_point submitBegin = Clock::now();
+    unit.submit();
+    Clock::time_point submitEnd = Clock::now();
+    if(NUM_WARMUP_FRAMES <= frame)
+    {
+      Clock::time_point lastFinish = *std::max_element(finishes.begin(), finishes.end());
+      recordingMicros.emplace_back(std::chrono::duration<double, std::micro>(lastFinish - release).count());
+      submitMicros.emplace_back(std::chrono::duration<double, std::micro>(submitEnd - submitBegin).count());
+    }
+  }
+  for(std::thread& thread : threads)
+  {
+    thread.join();
+  }
+  Percentiles recording = getPercentiles(recordingMicros);
+  Percentiles submit    = getPercentiles(submitMicros);
+  printf("%8u %-16s %10.1f %10.1f %10.1f %10.1f\n", numThreads, unitName, recording.m_median, recording.m_p99,
+         submit.m_median, submit.m_p99);
+}
+}  // namespace vkdd
+
+int main()
+{
+  using namespace vkdd;
+
+  VULKAN_HPP_DEFAULT_DISPATCHER.init();
+  vk::ApplicationInfo appInfo("vk_ddisplay command execution unit benchmark", 1, "nvpro-samples-engine", 1, VK_API_VERSION_1_3);
+  std::vector<char const*> extensions = {"VK_KHR_display", "VK_KHR_surface", "VK_EXT_direct_mode_display"};
+  vk::UniqueInstance       instance   = vk::createInstanceUnique({{}, &appInfo, {}, extensions});
+  VULKAN_HPP_DEFAULT_DISPATCHER.init(instance.get());
+  if(instance->enumeratePhysicalDeviceGroups().empty())
+  {
+    LOGE("No device group found.\n");
+    return 1;
+  }
+  LogicalDevice logicalDevice(instance.get(), 0);
+  if(!logicalDevice.start())
+  {
+    LOGE("Failed to start the logical device.\n");
+    return 1;
+  }
+
+  {
+    std::vector<RecordingThreadSemaphore> semaphores;
+    vk::SemaphoreTypeCreateInfo           semType(vk::SemaphoreType::eTimeline, 0);
+    for(uint32_t i = 0; i < MAX_RECORDING_THREADS; ++i)
+    {
+      semaphores.push_back({logicalDevice.vkDevice().createSemaphoreUnique({{}, &semType}), 0});
+    }
+    SingleMutexCommandExecutionUnit singleMutexUnit(logicalDevice);
+    CommandExecutionUnit            slotUnit(logicalDevice);
+    // slot 0 stays with the main thread like in the app
+    for(uint32_t i = 0; i < MAX_RECORDING_THREADS; ++i)
+    {
+      logicalDevice.registerRecordingThread();
+    }
+
+    printf("%u command buffer pairs per thread and frame, times per frame in us\n", NUM_PAIRS_PER_THREAD);
+    printf("%8s %-16s %10s %10s %10s %10s\n", "threads", "unit", "rec med", "rec p99", "submit med", "submit p99");
+    for(uint32_t numThreads = 1; numThreads <= MAX_RECORDING_THREADS; numThreads *= 2)
+    {
+      measureFrames(
+          "single mutex", singleMutexUnit, logicalDevice, semaphores, numThreads, [](uint32_t) {},
+          [&]() { singleMutexUnit.waitForIdleAndReset(); });
+      singleMutexUnit.waitForIdle();
+      measureFrames(
+          "recording slots", slotUnit, logicalDevice, semaphores, numThreads,
+          [](uint32_t i) { CommandExecutionUnit::bindRecordingSlot(i + 1); },
+          [&]() { slotUnit.waitForIdleAndReset(logicalDevice.getNumRecordingSlots()); });
+      slotUnit.waitForIdle();
+    }
+    logicalDevice.vkDevice().waitIdle();
+  }
+  return 0;
+}
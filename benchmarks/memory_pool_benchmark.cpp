@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "vkdd.hpp"
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+#include "vulkan_memory_pool.hpp"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+// replays an allocation trace against a memory pool for each slab policy: all allocations going through the free
+// interval lists of the pages, size classes which return every empty slab to its page, and size classes which keep the
+// last empty slab of each bin (the policy of the app)
+// a trace is a text file with one operation per line:
+//   a <id> <size> <alignment>   allocates a block, ids may be reused once their block has been freed
+//   f <id>                      frees the block of the id
+//   n                           ends a frame, empty pages are released like at the end of a frame of the app
+// without a trace file a synthetic trace is replayed which follows the app's pattern: per-frame buffers of 64 B to
+// 1 MiB, most of them small, which are freed once the queued frames are done, and a few long-living larger buffers
+// the pages are allocated from host memory instead of a Vulkan device, so the replay runs without a GPU and measures
+// the CPU cost of the pool only
+namespace vkdd {
+// hands out host memory as the memory of the pages, the handles are the host pointers
+class HostPageBackend : public VulkanMemoryPool::PageBackend
+{
+public:
+  vk::DeviceMemory allocate(vk::MemoryAllocateInfo const& allocateInfo) override
+  {
+    void* memory = std::malloc(allocateInfo.allocationSize);
+    if(!memory)
+    {
+      throw std::bad_alloc();
+    }
+    ++m_numAllocations;
+    return vk::DeviceMemory((VkDeviceMemory)(uintptr_t)memory);
+  }
+  void  free(vk::DeviceMemory devMem) override { std::free((void*)(uintptr_t)(VkDeviceMemory)devMem); }
+  void* map(vk::DeviceMemory devMem, size_t) override { return (void*)(uintptr_t)(VkDeviceMemory)devMem; }
+  void  unmap(vk::DeviceMemory) override {}
+
+  uint32_t getNumAllocations() const { return m_numAllocations; }
+
+private:
+  uint32_t m_numAllocations = 0;
+};
+
+struct TraceOp
+{
+  enum class Type
+  {
+    ALLOC,
+    FREE,
+    END_FRAME
+  };
+
+  Type     m_type;
+  uint32_t m_slot;
+  size_t   m_size;
+  size_t   m_alignment;
+};
+
+struct Trace
+{
+  std::vector<TraceOp> m_ops;
+  uint32_t             m_numSlots  = 0;
+  uint32_t             m_numAllocs = 0;
+};
+
+// the ids of a trace file are mapped to dense slots, so that the replay doesn't pay for a hash map lookup
+static bool loadTrace(char const* path, Trace& trace)
+{
+  std::ifstream file(path);
+  if(!file)
+  {
+    LOGE("Failed to open trace %s.\n", path);
+    return false;
+  }
+  std::unordered_map<uint64_t, uint32_t> idToSlot;
+  std::vector<uint32_t>                  freeSlots;
+  std::string                            line;
+  for(uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+  {
+    std::istringstream lineStream(line);
+    char               op = 0;
+    uint64_t           id = 0;
+    if(!(lineStream >> op))
+    {
+      continue;
+    }
+    if(op == 'n')
+    {
+      trace.m_ops.push_back({TraceOp::Type::END_FRAME, 0, 0, 0});
+      continue;
+    }
+    if(!(lineStream >> id))
+    {
+      LOGE("Missing id in line %u of the trace.\n", lineNumber);
+      return false;
+    }
+    auto it = idToSlot.find(id);
+    if(op == 'a')
+    {
+      size_t size      = 0;
+      size_t alignment = 1;
+      if(!(lineStream >> size >> alignment) || size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0
+         || it != idToSlot.end())
+      {
+        LOGE("Invalid allocation in line %u of the trace.\n", lineNumber);
+        return false;
+      }
+      uint32_t slot = trace.m_numSlots;
+      if(!freeSlots.empty())
+      {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+      }
+      else
+      {
+        ++trace.m_numSlots;
+      }
+      idToSlot.emplace(id, slot);
+      trace.m_ops.push_back({TraceOp::Type::ALLOC, slot, size, alignment});
+      ++trace.m_numAllocs;
+    }
+    else if(op == 'f' && it != idToSlot.end())
+    {
+      trace.m_ops.push_back({TraceOp::Type::FREE, it->second, 0, 0});
+      freeSlots.emplace_back(it->second);
+      idToSlot.erase(it);
+    }
+    else
+    {
+      LOGE("Invalid operation in line %u of the trace.\n", lineNumber);
+      return false;
+    }
+  }
+  return true;
+}
+
+static Trace generateTrace(uint32_t numFrames)
+{
+  static constexpr uint32_t NUM_ALLOCS_PER_FRAME = 200;
+  static constexpr uint32_t NUM_QUEUED_FRAMES    = DEFAULT_QUEUED_FRAMES;
+
+  Trace                                   trace;
+  std::mt19937                            rng(1);
+  std::uniform_real_distribution<float>   log2SizeDist(6.0f, 20.0f);
+  std::uniform_real_distribution<float>   longLivingLog2SizeDist(18.0f, 22.0f);
+  std::uniform_real_distribution<float>   chanceDist(0.0f, 1.0f);
+  std::uniform_int_distribution<uint32_t> lifetimeDist(100, 1000);
+  std::vector<uint32_t>                   freeSlots;
+  std::multimap<uint32_t, uint32_t>       slotsByFreeFrame;
+  std::array<size_t, 3> const             alignments = {16, 64, 256};
+  auto allocate = [&](size_t size, uint32_t freeFrame) {
+    uint32_t slot = trace.m_numSlots;
+    if(!freeSlots.empty())
+    {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    else
+    {
+      ++trace.m_numSlots;
+    }
+    trace.m_ops.push_back({TraceOp::Type::ALLOC, slot, size, alignments[rng() % alignments.size()]});
+    ++trace.m_numAllocs;
+    slotsByFreeFrame.emplace(freeFrame, slot);
+  };
+  for(uint32_t frame = 0; frame < numFrames; ++frame)
+  {
+    for(auto it = slotsByFreeFrame.begin(); it != slotsByFreeFrame.end() && it->first <= frame;
+        it = slotsByFreeFrame.erase(it))
+    {
+      trace.m_ops.push_back({TraceOp::Type::FREE, it->second, 0, 0});
+      freeSlots.emplace_back(it->second);
+    }
+    for(uint32_t i = 0; i < NUM_ALLOCS_PER_FRAME; ++i)
+    {
+      allocate((size_t)std::exp2(log2SizeDist(rng)), frame + NUM_QUEUED_FRAMES);
+    }
+    if(chanceDist(rng) < 0.02f)
+    {
+      allocate((size_t)std::exp2(longLivingLog2SizeDist(rng)), frame + lifetimeDist(rng));
+    }
+    trace.m_ops.push_back({TraceOp::Type::END_FRAME, 0, 0, 0});
+  }
+  for(auto const& it : slotsByFreeFrame)
+  {
+    trace.m_ops.push_back({TraceOp::Type::FREE, it.second, 0, 0});
+  }
+  return trace;
+}
+
+struct ReplayResult
+{
+  double                       m_nanosPerOp;
+  VulkanMemoryPool::Statistics m_peakStatistics;
+  uint32_t                     m_numMeasuredPageAllocations;
+};
+
+// the pool is reused by all passes, the first one is a warm-up which releases empty pages at the end of the frames
+// like the app does and provides the peak statistics
+// the measured passes keep the empty pages resident, so that they time the allocations and frees rather than the
+// page allocations, the fastest of them is reported
+static ReplayResult replayTrace(Trace const& trace, VulkanMemoryPool::SlabPolicy slabPolicy, uint32_t numPasses)
+{
+  HostPageBackend  pageBackend;
+  VulkanMemoryPool pool(vk::Device(), DeviceMask(), 0, false, 4 << 20, slabPolicy, &pageBackend);
+  std::vector<VulkanMemoryPool::Allocation> allocations(trace.m_numSlots);
+  ReplayResult                              result = {std::numeric_limits<double>::max(), {}, 0};
+  uint32_t                                  numWarmUpPageAllocations = 0;
+  for(uint32_t pass = 0; pass <= numPasses; ++pass)
+  {
+    bool const warmUp = pass == 0;
+
+    std::chrono::steady_clock::duration   duration(0);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for(TraceOp const& op : trace.m_ops)
+    {
+      switch(op.m_type)
+      {
+        case TraceOp::Type::ALLOC:
+          allocations[op.m_slot] = pool.alloc(op.m_size, op.m_alignment);
+          break;
+        case TraceOp::Type::FREE:
+          allocations[op.m_slot].free();
+          break;
+        case TraceOp::Type::END_FRAME:
+          if(!warmUp)
+          {
+            break;
+          }
+          // the statistics and the page releases are not part of the measured time
+          duration += std::chrono::steady_clock::now() - begin;
+          {
+            VulkanMemoryPool::Statistics stats = pool.collectStatistics();
+            if(result.m_peakStatistics.m_reservedBytes < stats.m_reservedBytes)
+            {
+              result.m_peakStatistics = stats;
+            }
+          }
+          pool.releaseEmptyPages(600, 1);
+          begin = std::chrono::steady_clock::now();
+          break;
+      }
+    }
+    for(VulkanMemoryPool::Allocation& allocation : allocations)
+    {
+      allocation.free();
+    }
+    duration += std::chrono::steady_clock::now() - begin;
+    if(warmUp)
+    {
+      numWarmUpPageAllocations = pageBackend.getNumAllocations();
+    }
+    else
+    {
+      // every allocation is freed again, so there are twice as many operations as allocations
+      double nanos        = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+      result.m_nanosPerOp = std::min(result.m_nanosPerOp, nanos / (2.0 * trace.m_numAllocs));
+    }
+  }
+  result.m_numMeasuredPageAllocations = pageBackend.getNumAllocations() - numWarmUpPageAllocations;
+  return result;
+}
+}  // namespace vkdd
+
+int main(int argc, char const* argv[])
+{
+  using namespace vkdd;
+
+  Trace trace;
+  if(1 < argc)
+  {
+    if(!loadTrace(argv[1], trace))
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    trace = generateTrace(2000);
+  }
+  if(trace.m_numAllocs == 0)
+  {
+    LOGE("The trace does not contain any allocations.\n");
+    return 1;
+  }
+
+  std::array<std::pair<char const*, VulkanMemoryPool::SlabPolicy>, 3> const policies = {
+      std::make_pair("interval lists only", VulkanMemoryPool::SlabPolicy::NO_SLABS),
+      std::make_pair("release empty slabs", VulkanMemoryPool::SlabPolicy::RELEASE_EMPTY_SLABS),
+      std::make_pair("keep last empty slab", VulkanMemoryPool::SlabPolicy::KEEP_LAST_EMPTY_SLAB)};
+  printf("%zu operations, %u allocations\n", trace.m_ops.size(), trace.m_numAllocs);
+  printf("%-24s %12s %12s %10s %16s %16s\n", "policy", "ns/op", "peak MiB", "pages", "free intervals",
+         "measured pages");
+  for(auto const& policy : policies)
+  {
+    ReplayResult result = replayTrace(trace, policy.second, 5);
+    printf("%-24s %12.1f %12.1f %10zu %16zu %16u\n", policy.first, result.m_nanosPerOp,
+           (double)result.m_peakStatistics.m_reservedBytes / (1 << 20), result.m_peakStatistics.m_numPages,
+           result.m_peakStatistics.m_numFreeIntervals, result.m_numMeasuredPageAllocations);
+  }
+  return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "vkdd.hpp"
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+#include "task_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+// measures the per-frame handoff between the main thread and the recording threads for 1 to 32 render threads:
+// dispatch-to-start is the time from handing out a render thread's recording until it starts, averaged over the render
+// threads of a frame, and finish-to-join is the time from the last recording finishing until the main thread returns
+// from joining them
+// the handoffs compared are
+//   condvar threads  a dedicated thread per render thread, woken and joined through its mutex and condition variable,
+//                    like the render threads did before they became tasks
+//   pool, parking    the task pool with idle threads parking right away
+//   pool, spinning   the task pool with idle threads spinning before they park, as used by the app
+// every recording is a busy loop of a few microseconds, and between two frames the main thread is busy for a short and
+// for a long gap, the long gap lets spinning threads give up and park
+// an optional argument overrides the spin iterations of the spinning pool
+
+namespace vkdd {
+typedef std::chrono::steady_clock Clock;
+
+static constexpr uint32_t                  NUM_WARMUP_FRAMES = 50;
+static constexpr uint32_t                  NUM_FRAMES        = 1000;
+static constexpr std::chrono::microseconds RECORDING_DURATION(20);
+
+struct RecordingTimes
+{
+  Clock::time_point m_dispatch;
+  Clock::time_point m_start;
+  Clock::time_point m_finish;
+};
+
+struct Percentiles
+{
+  double m_median;
+  double m_p99;
+};
+
+static void busyWait(std::chrono::microseconds duration)
+{
+  Clock::time_point end = Clock::now() + duration;
+  while(Clock::now() < end)
+  {
+  }
+}
+
+static void record(RecordingTimes& times)
+{
+  times.m_start = Clock::now();
+  busyWait(RECORDING_DURATION);
+  times.m_finish = Clock::now();
+}
+
+static Percentiles getPercentiles(std::vector<double>& micros)
+{
+  std::sort(micros.begin(), micros.end());
+  return {micros[micros.size() / 2], micros[micros.size() * 99 / 100]};
+}
+
+// the handoff of a render thread before the task pool, the recording runs while the thread holds its mutex
+class CondVarThread
+{
+public:
+  explicit CondVarThread(RecordingTimes& times)
+      : m_status(Status::CREATED)
+      , m_times(times)
+  {
+    m_thread = std::thread([this]() {
+      std::unique_lock lock(m_mtx);
+      while(m_status != Status::INTERRUPTED)
+      {
+        if(m_status == Status::RECORDING)
+        {
+          record(m_times);
+        }
+        m_status = Status::WAITING;
+        m_cv.notify_all();
+        m_cv.wait(lock, [this]() { return m_status != Status::WAITING; });
+      }
+    });
+  }
+
+  ~CondVarThread()
+  {
+    {
+      std::unique_lock lock(m_mtx);
+      m_status = Status::INTERRUPTED;
+      m_cv.notify_all();
+    }
+    m_thread.join();
+  }
+
+  void recordAsync()
+  {
+    std::unique_lock lock(m_mtx);
+    m_status = Status::RECORDING;
+    m_cv.notify_all();
+  }
+
+  void finishRecording()
+  {
+    std::unique_lock lock(m_mtx);
+    if(m_status == Status::RECORDING)
+    {
+      m_cv.wait(lock, [this]() { return m_status == Status::WAITING; });
+    }
+  }
+
+private:
+  enum class Status
+  {
+    CREATED,
+    RECORDING,
+    WAITING,
+    INTERRUPTED
+  };
+
+  Status                  m_status;
+  RecordingTimes&         m_times;
+  std::thread             m_thread;
+  std::mutex              m_mtx;
+  std::condition_variable m_cv;
+};
+
+// dispatch hands out the recording of one render thread, join waits for all of them
+static void measureFrames(char const*                          handoffName,
+                          std::vector<RecordingTimes>&         times,
+                          std::chrono::microseconds            gap,
+                          std::function<void(uint32_t)> const& dispatch,
+                          std::function<void()> const&         join)
+{
+  std::vector<double> dispatchToStartMicros;
+  std::vector<double> finishToJoinMicros;
+  for(uint32_t frame = 0; frame < NUM_WARMUP_FRAMES + NUM_FRAMES; ++frame)
+  {
+    busyWait(gap);
+    for(uint32_t i = 0; i < times.size(); ++i)
+    {
+      times[i].m_dispatch = Clock::now();
+      dispatch(i);
+    }
+    join();
+    Clock::time_point joined = Clock::now();
+    if(frame < NUM_WARMUP_FRAMES)
+    {
+      continue;
+    }
+    double            dispatchToStart = 0.0;
+    Clock::time_point lastFinish      = times.front().m_finish;
+    for(RecordingTimes const& t : times)
+    {
+      dispatchToStart += std::chrono::duration<double, std::micro>(t.m_start - t.m_dispatch).count();
+      lastFinish = std::max(lastFinish, t.m_finish);
+    }
+    dispatchToStartMicros.emplace_back(dispatchToStart / times.size());
+    finishToJoinMicros.emplace_back(std::chrono::duration<double, std::micro>(joined - lastFinish).count());
+  }
+  Percentiles dispatchToStart = getPercentiles(dispatchToStartMicros);
+  Percentiles finishToJoin    = getPercentiles(finishToJoinMicros);
+  printf("%8zu %8lld %-16s %10.2f %10.2f %10.2f %10.2f\n", times.size(), (long long)gap.count(), handoffName,
+         dispatchToStart.m_median, dispatchToStart.m_p99, finishToJoin.m_median, finishToJoin.m_p99);
+}
+
+static void measurePool(char const* handoffName, TaskPool& pool, std::vector<RecordingTimes>& times, std::chrono::microseconds gap)
+{
+  TaskGroup group;
+  measureFrames(
+      handoffName, times, gap, [&](uint32_t i) { pool.run(group, [&times, i]() { record(times[i]); }); },
+      [&]() { pool.wait(group); });
+}
+}  // namespace vkdd
+
+int main(int argc, char const* argv[])
+{
+  using namespace vkdd;
+
+  uint32_t spinIterations = 1 < argc ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : TaskPool::DEFAULT_SPIN_ITERATIONS;
+  uint32_t numWorkers     = std::max(1u, std::thread::hardware_concurrency()) - 1;
+  TaskPool parkingPool(numWorkers, 0);
+  TaskPool spinningPool(numWorkers, spinIterations);
+  printf("%u workers, %u spin iterations, %lld us per recording, latencies in us\n", numWorkers, spinIterations,
+         (long long)RECORDING_DURATION.count());
+  printf("%8s %8s %-16s %10s %10s %10s %10s\n", "threads", "gap us", "handoff", "d2s med", "d2s p99", "f2j med", "f2j p99");
+  for(uint32_t numThreads = 1; numThreads <= 32; numThreads *= 2)
+  {
+    for(std::chrono::microseconds gap : {std::chrono::microseconds(50), std::chrono::microseconds(2000)})
+    {
+      std::vector<RecordingTimes> times(numThreads);
+      {
+        std::vector<std::unique_ptr<CondVarThread>> threads;
+        for(RecordingTimes& t : times)
+        {
+          threads.emplace_back(std::make_unique<CondVarThread>(t));
+        }
+        measureFrames(
+            "condvar threads", times, gap, [&](uint32_t i) { threads[i]->recordAsync(); },
+            [&]() {
+              for(std::unique_ptr<CondVarThread> const& thread : threads)
+              {
+                thread->finishRecording();
+              }
+            });
+      }
+      measurePool("pool, parking", parkingPool, times, gap);
+      measurePool("pool, spinning", spinningPool, times, gap);
+    }
+  }
+  return 0;
+}
@@ -28,5 +28,7 @@ struct BufferAllocation
 public:
   vk::UniqueBuffer             m_buffer;
   VulkanMemoryPool::Allocation m_allocation;
+  vk::DeviceSize               m_size = 0;
+  vk::BufferUsageFlags         m_usage;
 };
 }  // namespace vkdd
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "buffer_suballocator.hpp"
+
+#include "free_interval_list.hpp"
+#include "logical_device.hpp"
+
+namespace vkdd {
+struct Block
+{
+  BufferAllocation m_bufferAllocation;
+  FreeIntervalList m_freeIntervals;
+  size_t           m_blockIndex;
+};
+
+BufferSuballocator::Range::Range()
+    : Range(nullptr, nullptr, nullptr, 0, 0)
+{
+}
+
+BufferSuballocator::Range::Range(Range&& other)
+    : m_suballocator(other.m_suballocator)
+    , m_block(other.m_block)
+    , m_buffer(other.m_buffer)
+    , m_offset(other.m_offset)
+    , m_size(other.m_size)
+{
+  other.clear();
+}
+
+BufferSuballocator::Range::Range(BufferSuballocator* suballocator, Block* block, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size)
+    : m_suballocator(suballocator)
+    , m_block(block)
+    , m_buffer(buffer)
+    , m_offset(offset)
+    , m_size(size)
+{
+}
+
+BufferSuballocator::Range::~Range()
+{
+  this->free();
+}
+
+BufferSuballocator::Range& BufferSuballocator::Range::operator=(Range&& other)
+{
+  if(this != &other)
+  {
+    this->free();
+    m_suballocator = other.m_suballocator;
+    m_block        = other.m_block;
+    m_buffer       = other.m_buffer;
+    m_offset       = other.m_offset;
+    m_size         = other.m_size;
+    other.clear();
+  }
+  return *this;
+}
+
+void BufferSuballocator::Range::free()
+{
+  if(m_suballocator)
+  {
+    m_suballocator->free(*this);
+    this->clear();
+  }
+}
+
+void BufferSuballocator::Range::clear()
+{
+  m_suballocator = nullptr;
+  m_block        = nullptr;
+  m_buffer       = nullptr;
+  m_offset       = 0;
+  m_size         = 0;
+}
+
+BufferSuballocator::BufferSuballocator(LogicalDevice&          logicalDevice,
+                                       OptionalDeviceIndex     deviceIndex,
+                                       vk::BufferUsageFlags    usage,
+                                       vk::MemoryPropertyFlags memPropFlags,
+                                       vk::DeviceSize          minBlockSize)
+    : m_logicalDevice(logicalDevice)
+    , m_deviceIndex(deviceIndex)
+    , m_usage(usage)
+    , m_memPropFlags(memPropFlags)
+    , m_minBlockSize(minBlockSize)
+{
+}
+
+BufferSuballocator::~BufferSuballocator() {}
+
+BufferSuballocator::Range BufferSuballocator::alloc(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+  std::lock_guard guard(m_mtx);
+  for(std::unique_ptr<Block> const& block : m_blocks)
+  {
+    std::optional<Interval> interval = block->m_freeIntervals.requestInterval(size, alignment);
+    if(interval.has_value())
+    {
+      return {this, block.get(), block->m_bufferAllocation.m_buffer.get(), interval.value().m_begin, size};
+    }
+  }
+  vk::DeviceSize         blockSize = std::max(size, m_minBlockSize);
+  vk::BufferCreateInfo   createInfo({}, blockSize, m_usage, vk::SharingMode::eExclusive);
+  std::unique_ptr<Block> block     = std::make_unique<Block>(Block{{}, FreeIntervalList(blockSize), m_blocks.size()});
+  block->m_bufferAllocation = m_logicalDevice.allocateBuffer(m_deviceIndex, createInfo, m_memPropFlags);
+  Interval interval         = block->m_freeIntervals.requestInterval(size, alignment).value();
+  Block&   newBlock         = *m_blocks.emplace_back(std::move(block));
+  return {this, &newBlock, newBlock.m_bufferAllocation.m_buffer.get(), interval.m_begin, size};
+}
+
+void BufferSuballocator::free(Range const& range)
+{
+  std::lock_guard guard(m_mtx);
+  range.m_block->m_freeIntervals.returnInterval({range.m_offset, range.m_offset + range.m_size});
+  // ranges are only freed once the GPU is done with them, so an unused block can be destroyed right away, but the last
+  // one is kept for the next allocation
+  if(range.m_block->m_freeIntervals.isUnused() && 1 < m_blocks.size())
+  {
+    size_t blockIndex                  = range.m_block->m_blockIndex;
+    m_blocks[blockIndex]               = std::move(m_blocks.back());
+    m_blocks[blockIndex]->m_blockIndex = blockIndex;
+    m_blocks.pop_back();
+  }
+}
+}  // namespace vkdd
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "vkdd.hpp"
+
+#include "buffer_allocation.hpp"
+
+namespace vkdd {
+// vk_ddisplay
+// a buffer suballocator owns a few large buffers of a single usage class and hands out ranges of them, so that objects
+// which are reallocated regularly don't create and destroy a vkBuffer every time
+class BufferSuballocator
+{
+public:
+  class Range;
+
+  BufferSuballocator(class LogicalDevice&    logicalDevice,
+                     OptionalDeviceIndex     deviceIndex,
+                     vk::BufferUsageFlags    usage,
+                     vk::MemoryPropertyFlags memPropFlags,
+                     vk::DeviceSize          minBlockSize = 4 << 20);
+  ~BufferSuballocator();
+
+  Range alloc(vk::DeviceSize size, vk::DeviceSize alignment);
+
+private:
+  LogicalDevice&                             m_logicalDevice;
+  OptionalDeviceIndex                        m_deviceIndex;
+  vk::BufferUsageFlags                       m_usage;
+  vk::MemoryPropertyFlags                    m_memPropFlags;
+  vk::DeviceSize                             m_minBlockSize;
+  std::vector<std::unique_ptr<struct Block>> m_blocks;
+  std::mutex                                 m_mtx;
+
+  void free(Range const& range);
+};
+
+class BufferSuballocator::Range
+{
+public:
+  Range();
+  Range(Range&& other);
+  ~Range();
+
+  Range& operator=(Range&& other);
+
+  void           free();
+  vk::Buffer     buffer() const { return m_buffer; }
+  vk::DeviceSize offset() const { return m_offset; }
+  vk::DeviceSize size() const { return m_size; }
+
+private:
+  friend class BufferSuballocator;
+
+  BufferSuballocator* m_suballocator;
+  struct Block*       m_block;
+  vk::Buffer          m_buffer;
+  vk::DeviceSize      m_offset;
+  vk::DeviceSize      m_size;
+
+  Range(BufferSuballocator* suballocator, struct Block* block, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size);
+
+  void clear();
+};
+}  // namespace vkdd
@@ -22,25 +22,34 @@
 #include "command_execution_unit.hpp"
 #include "logical_device.hpp"
 #include "scene.hpp"
+#include "triangle_mesh.hpp"
 #include "triangle_mesh_instance_set.hpp"
 #include "vulkan_memory_object_uploader.hpp"
 
 namespace vkdd {
-CanvasRegionRenderThread::CanvasRegionRenderThread(class Scene const& scene,
-                                                   LogicalDevice&     logicalDevice,
-                                                   DeviceIndex        deviceIndex,
-                                                   vk::Rect2D         renderArea,
-                                                   vk::Viewport       viewport)
+static constexpr float MAX_FUR_EXTRUSION = 0.3f;
+
+CanvasRegionRenderThread::CanvasRegionRenderThread(LogicalDevice& logicalDevice,
+                                                   DeviceIndex    deviceIndex,
+                                                   vk::Rect2D     renderArea,
+                                                   vk::Viewport   viewport)
     : RenderThread(logicalDevice, deviceIndex)
-    , m_scene(scene)
     , m_renderArea(renderArea)
     , m_viewport(viewport)
     , m_instances(std::make_unique<TriangleMeshInstanceSet>(logicalDevice, deviceIndex))
     , m_highlighted(false)
+    , m_renderGraph(logicalDevice)
+    , m_secondaryCmdBuffer(nullptr)
+    , m_globalDataDescriptorSets{}
+    , m_cachedRenderCommands{}
+    , m_nodeCapacity(0)
 {
 }
 
-void CanvasRegionRenderThread::recordCommands(class CommandExecutionUnit& cmdExecUnit, vk::Framebuffer framebuffer)
+void CanvasRegionRenderThread::recordCommands(class CommandExecutionUnit& cmdExecUnit,
+                                              SceneSnapshot const&        scene,
+                                              vk::Framebuffer             framebuffer,
+                                              bool                        useSecondaryCmdBuffer)
 {
   std::array<Vec3f, 14> const COLORS = {Colors::STRONG_RED, Colors::GREEN_NV, Colors::BONDI_BLUE, Colors::RED,
                                         Colors::GREEN,      Colors::BLUE,     Colors::CYAN,       Colors::MAGENTA,
@@ -50,99 +59,328 @@ void CanvasRegionRenderThread::recordCommands(class CommandExecutionUnit& cmdExe
   m_lastClearColor = COLORS[this->getSystemPhysicalDeviceIndex() % sizeof(COLORS[0])];
   if(m_highlighted)
   {
-    m_lastClearColor = lerp(m_lastClearColor, Colors::DARK_GRAY, 0.5f + 0.5f * std::sinf(1e-2f * m_scene.getRuntimeMillis()));
+    m_lastClearColor = lerp(m_lastClearColor, Colors::DARK_GRAY, 0.5f + 0.5f * std::sinf(1e-2f * scene.m_runtimeMillis));
   }
 
+  // for a simple fur effect the app renders the same geometry in multiple layers (or shells), where each additional
+  // layer discards more fragments than the previous
+  m_numFurLayers            = std::max(1, m_numFurLayers);
+  uint32_t numFurLayers     = (uint32_t)m_numFurLayers;
+  bool     generateOnDevice = this->getLogicalDevice().isAsyncComputeEnabled();
   m_instances->beginInstanceCollection();
-  m_scene.collectVisibleNodes({}, {}, [this](Scene::Node const& node) {
+  m_nodeTransforms.clear();
+  for(SceneSnapshot::Node const& node : scene.m_nodes)
+  {
     // right now the app only supports torus geometry
     // in practice you would first want to check the torus' visibility in this render context before adding its
     // instances (we may add this in a later update)
-    if(node.getNodeType() == Scene::NodeType::TORUS)
+    if(node.m_nodeType != Scene::NodeType::TORUS)
     {
-      // for a simple fur effect the app renders the same geometry in multiple layers (or shells), where each additional
-      // layer discards more fragments than the previous
-      m_numFurLayers       = std::max(1, m_numFurLayers);
-      float   maxExtrusion = 0.3f;
-      Mat4x4f model        = node.createModel();
-      for(int32_t i = 0; i < m_numFurLayers; ++i)
-      {
-        float shellHeight = (float)i / (float)m_numFurLayers;
-        float extrusion   = maxExtrusion * shellHeight;
-        m_instances->pushInstance(node.getId(), model, shellHeight, extrusion);
-      }
+      continue;
     }
-  });
+    if(generateOnDevice)
+    {
+      m_nodeTransforms.emplace_back(NodeTransform{node.m_model, node.m_id});
+      m_instances->pushGeneratedInstances(numFurLayers);
+      continue;
+    }
+    for(uint32_t i = 0; i < numFurLayers; ++i)
+    {
+      float shellHeight = (float)i / (float)numFurLayers;
+      float extrusion   = MAX_FUR_EXTRUSION * shellHeight;
+      m_instances->pushInstance(node.m_id, node.m_model, shellHeight, extrusion);
+    }
+  }
   m_instances->endInstanceCollection();
 
-  std::vector<uint32_t> queueFamilyIndices = {this->getLogicalDevice().getGraphicsQueueFamilyIndex()};
-  if(m_instances->getNumInstances() != 0)
+  // vk_ddisplay
+  // the instance buffer and the global data are updated through a dedicated transfer Vulkan queue which requires proper
+  // synchronization and queue ownership transfers. these are derived by the render graph from the passes' accesses
+  // with async compute the instances are written by a compute pass instead. the instances and the global data are
+  // double-buffered, so their writes only wait for the draw that read the same buffers two frames ago
+  bool                         hasInstances       = m_instances->getNumInstances() != 0;
+  TriangleMesh*                donutTriMesh       = nullptr;
+  uint32_t                     bufferIndex        = m_instances->getBufferIndex();
+  RenderGraph::BufferResource& instanceResource   = m_instanceResources[bufferIndex];
+  RenderGraph::BufferResource& globalDataResource = m_globalDataResources[bufferIndex];
+  if(hasInstances)
   {
-    queueFamilyIndices.emplace_back(this->getLogicalDevice().getTransferQueueFamilyIndex());
+    donutTriMesh = this->getLogicalDevice().getDonutTriangleMesh(this->getDeviceIndex(), 16);
+    this->prepareGlobalData();
+    instanceResource.setRange(m_instances->getBuffer(), m_instances->getBufferOffset(), m_instances->getBufferSize());
+    globalDataResource.setRange(m_globalDataRanges[bufferIndex].buffer(), m_globalDataRanges[bufferIndex].offset(),
+                                sizeof(GlobalData));
+    std::vector<RenderGraph::ResourceAccess> transferAccesses = {
+        RenderGraph::write(globalDataResource, vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite)};
+    if(!generateOnDevice)
+    {
+      transferAccesses.emplace_back(
+          RenderGraph::write(instanceResource, vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite));
+    }
+    m_renderGraph.addPass(this->getLogicalDevice().getTransferQueueFamilyIndex(), transferAccesses,
+                          [this, &scene, generateOnDevice](RenderGraph::PassContext& context) {
+                            if(!generateOnDevice)
+                            {
+                              m_instances->updateDeviceMemory(context.m_cmdBuffer,
+                                                              this->allocateFrameStagingMemory(m_instances->getBufferSize()));
+                            }
+                            this->updateGlobalData(context.m_cmdBuffer, scene);
+                          });
+    if(generateOnDevice)
+    {
+      if(m_nodeCapacity < m_nodeTransforms.size())
+      {
+        this->getLogicalDevice().scheduleForDeallocation(std::move(m_nodeRange));
+        m_nodeCapacity = std::max((uint32_t)m_nodeTransforms.size(), std::max(16U, 2U * m_nodeCapacity));
+        m_nodeRange    = this->getLogicalDevice().allocateInstanceBufferRange(this->getDeviceIndex(),
+                                                                              m_nodeCapacity * sizeof(NodeTransform));
+      }
+      // the node transforms are only accessed by the compute pass, the graph just has to order it with the compute
+      // pass of the previous frame
+      m_nodeResource.setRange(m_nodeRange.buffer(), m_nodeRange.offset(), m_nodeTransforms.size() * sizeof(NodeTransform));
+      m_renderGraph.addPass(
+          this->getLogicalDevice().getComputeQueueFamilyIndex().value(),
+          {RenderGraph::write(m_nodeResource, vk::PipelineStageFlagBits2::eCopy | vk::PipelineStageFlagBits2::eComputeShader,
+                              vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageRead),
+           RenderGraph::write(instanceResource, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite)},
+          [this, numFurLayers](RenderGraph::PassContext& context) {
+            this->generateInstances(context.m_cmdBuffer, numFurLayers);
+          });
+    }
   }
-  std::vector<vk::CommandBuffer> cmdBuffers =
-      cmdExecUnit.requestCommandBuffers(queueFamilyIndices, DeviceMask::ofSingleDevice(this->getDeviceIndex()));
 
-  vk::CommandBuffer graphicsCmdBuffer = cmdBuffers.front();
-  cmdExecUnit.pushWait(graphicsCmdBuffer, {this->getImageAcquiredSemaphore(), 0,
-                                           vk::PipelineStageFlagBits2::eColorAttachmentOutput, this->getDeviceIndex()});
-  graphicsCmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-  if(m_instances->getNumInstances() != 0)
+  // the render commands are either recorded inline into the draw pass' command buffer, into a secondary command buffer
+  // of this frame, or they are taken from the cache
+  // with secondary command buffers they are executed inside the logical display's render pass, the draw pass' command
+  // buffer then only acquires the instance buffer and the global data from the transfer or compute queue
+  std::vector<RenderGraph::ResourceAccess> drawAccesses;
+  if(hasInstances)
   {
-    if(!m_syncTimelineSemaphore)
-    {
-      vk::SemaphoreTypeCreateInfo semType({vk::SemaphoreType::eTimeline});
-      m_syncTimelineSemaphore      = this->getLogicalDevice().vkDevice().createSemaphoreUnique({{}, &semType});
-      m_syncTimelineSemaphoreValue = 0;
-    }
-    GlobalData globalData      = {};
-    globalData.m_view          = m_scene.getCamera().m_view;
-    globalData.m_proj          = m_scene.getCamera().m_proj;
-    globalData.m_runtimeMillis = m_scene.getRuntimeMillis();
-
-    // the instance buffer will be updated through a dedicated transfer Vulkan queue which requires proper
-    // synchronization and queu ownership transfers
-    vk::CommandBuffer transferCmdBuffer = cmdBuffers.back();
-    cmdExecUnit.pushWait(transferCmdBuffer, {m_syncTimelineSemaphore.get(), m_syncTimelineSemaphoreValue,
-                                             vk::PipelineStageFlagBits2::eTransfer, this->getDeviceIndex()});
-    transferCmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-    m_instances->updateDeviceMemory(transferCmdBuffer, graphicsCmdBuffer);
-    transferCmdBuffer.end();
-    cmdExecUnit.pushSignal(transferCmdBuffer, {m_syncTimelineSemaphore.get(), ++m_syncTimelineSemaphoreValue,
-                                               vk::PipelineStageFlagBits2::eTransfer, this->getDeviceIndex()});
-
-    cmdExecUnit.pushWait(graphicsCmdBuffer, {m_syncTimelineSemaphore.get(), m_syncTimelineSemaphoreValue,
-                                             vk::PipelineStageFlagBits2::eVertexAttributeInput, this->getDeviceIndex()});
+    drawAccesses = {RenderGraph::read(instanceResource, vk::PipelineStageFlagBits2::eVertexAttributeInput,
+                                      vk::AccessFlagBits2::eVertexAttributeRead),
+                    RenderGraph::read(globalDataResource, vk::PipelineStageFlagBits2::eVertexShader,
+                                      vk::AccessFlagBits2::eUniformRead)};
+  }
+  uint32_t          graphicsQueueFamilyIndex = this->getLogicalDevice().getGraphicsQueueFamilyIndex();
+  vk::CommandBuffer renderCmdBuffer;
+  m_secondaryCmdBuffer = nullptr;
+  m_renderGraph.addPass(graphicsQueueFamilyIndex, drawAccesses, [&](RenderGraph::PassContext& context) {
+    vk::CommandBuffer           graphicsCmdBuffer = context.m_cmdBuffer;
     vk::ClearColorValue         clearColorValue(m_lastClearColor.x, m_lastClearColor.y, m_lastClearColor.z, 1.0f);
     vk::ClearDepthStencilValue  clearDepthStencil(1.0f, 0U);
     std::vector<vk::ClearValue> clearValues = {clearColorValue, clearDepthStencil};
     vk::RenderPassBeginInfo renderPassBegin(this->getLogicalDevice().getDonutRenderPass(), framebuffer, m_renderArea, clearValues);
-    graphicsCmdBuffer.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
-    graphicsCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, this->getLogicalDevice().getDonutPipeline());
-    graphicsCmdBuffer.pushConstants<GlobalData>(this->getLogicalDevice().getDonutPipelineLayout(),
-                                                vk::ShaderStageFlagBits::eVertex, 0, globalData);
-    TriangleMesh* donutTriMesh = this->getLogicalDevice().getDonutTriangleMesh(this->getDeviceIndex(), 16);
-    // the vertex and index buffers of the triangle mesh might not be ready yet
-    // in that case one has to synchronize with its timeline semaphore
-    if(this->getLogicalDevice().getCurrentFrameIndex() < donutTriMesh->getAvailableFrameIndex())
+    if(hasInstances && this->getLogicalDevice().isRenderCommandCachingEnabled())
     {
-      cmdExecUnit.pushWait(graphicsCmdBuffer, {this->getLogicalDevice().getUploader().getSyncSemaphore(),
-                                               this->getLogicalDevice().getCurrentFrameIndex() + 1,
-                                               vk::PipelineStageFlagBits2::eVertexAttributeInput, this->getDeviceIndex()});
+      vk::CommandBuffer cachedCmdBuffer = this->getCachedRenderCommands(*donutTriMesh);
+      if(useSecondaryCmdBuffer)
+      {
+        cmdExecUnit.registerSecondaryCommandBuffer(cachedCmdBuffer, graphicsQueueFamilyIndex);
+        m_secondaryCmdBuffer = cachedCmdBuffer;
+      }
+      else
+      {
+        graphicsCmdBuffer.beginRenderPass(renderPassBegin, vk::SubpassContents::eSecondaryCommandBuffers);
+        graphicsCmdBuffer.executeCommands(cachedCmdBuffer);
+        graphicsCmdBuffer.endRenderPass();
+      }
     }
-    graphicsCmdBuffer.setViewport(0, m_viewport);
-
-    // vk_ddisplay
-    // one must ensure to only render to the parts of the surface which are covered by the physical device's present
-    // rectangles. the easiest way to do this is by setting up the scissor rectangle(s) appropriately
-    graphicsCmdBuffer.setScissor(0, m_renderArea);
-    m_instances->draw(graphicsCmdBuffer, *donutTriMesh);
-    graphicsCmdBuffer.endRenderPass();
-    cmdExecUnit.pushSignal(graphicsCmdBuffer, {m_syncTimelineSemaphore.get(), ++m_syncTimelineSemaphoreValue,
-                                               vk::PipelineStageFlagBits2::eVertexAttributeInput, this->getDeviceIndex()});
+    else
+    {
+      if(useSecondaryCmdBuffer)
+      {
+        m_secondaryCmdBuffer = cmdExecUnit.requestSecondaryCommandBuffer(graphicsQueueFamilyIndex);
+        vk::CommandBufferInheritanceInfo inheritanceInfo(this->getLogicalDevice().getDonutRenderPass(), 0, framebuffer);
+        m_secondaryCmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                                    &inheritanceInfo});
+        if(hasInstances)
+        {
+          this->recordRenderCommands(m_secondaryCmdBuffer, *donutTriMesh);
+        }
+        m_secondaryCmdBuffer.end();
+      }
+      else if(hasInstances)
+      {
+        graphicsCmdBuffer.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
+        this->recordRenderCommands(graphicsCmdBuffer, *donutTriMesh);
+        graphicsCmdBuffer.endRenderPass();
+      }
+    }
+    // the render commands of a secondary command buffer are finished once its executing command buffer is
+    renderCmdBuffer           = m_secondaryCmdBuffer ? m_secondaryCmdBuffer : graphicsCmdBuffer;
+    context.m_signalCmdBuffer = renderCmdBuffer;
+  });
+  m_renderGraph.execute(cmdExecUnit, this->getDeviceIndex());
+
+  // the vertex and index buffers of the triangle mesh might not be ready yet
+  // in that case one has to synchronize with its timeline semaphore
+  if(hasInstances && this->getLogicalDevice().getCurrentFrameIndex() < donutTriMesh->getAvailableFrameIndex())
+  {
+    cmdExecUnit.pushWait(renderCmdBuffer, {this->getLogicalDevice().getUploader().getSyncSemaphore(),
+                                           this->getLogicalDevice().getCurrentFrameIndex() + 1,
+                                           vk::PipelineStageFlagBits2::eVertexAttributeInput, this->getDeviceIndex()});
   }
-  graphicsCmdBuffer.end();
-  cmdExecUnit.pushSignal(graphicsCmdBuffer, {this->getRenderDoneSemaphore(), 0,
-                                             vk::PipelineStageFlagBits2::eColorAttachmentOutput, this->getDeviceIndex()});
+  cmdExecUnit.pushWait(renderCmdBuffer, {this->getImageAcquiredSemaphore(), 0,
+                                         vk::PipelineStageFlagBits2::eColorAttachmentOutput, this->getDeviceIndex()});
+  cmdExecUnit.pushSignal(renderCmdBuffer, {this->getRenderDoneSemaphore(), 0,
+                                           vk::PipelineStageFlagBits2::eColorAttachmentOutput, this->getDeviceIndex()});
+}
+
+void CanvasRegionRenderThread::resizeFrameRings()
+{
+  RenderThread::resizeFrameRings();
+  // the descriptor pools are created on demand, only the ones of removed slots are released
+  for(uint32_t slot = this->getLogicalDevice().getNumQueuedFrames(); slot < MAX_QUEUED_FRAMES; ++slot)
+  {
+    m_computeDescriptorPools[slot].reset();
+  }
+}
+
+void CanvasRegionRenderThread::prepareGlobalData()
+{
+  if(m_descriptorPool)
+  {
+    return;
+  }
+  // one global data buffer and descriptor set for each of the alternating instance buffers
+  LogicalDevice&         logicalDevice = this->getLogicalDevice();
+  vk::DescriptorPoolSize poolSize(vk::DescriptorType::eUniformBuffer, 2 * TriangleMeshInstanceSet::NUM_BUFFERS);
+  m_descriptorPool = logicalDevice.vkDevice().createDescriptorPoolUnique({{}, TriangleMeshInstanceSet::NUM_BUFFERS, poolSize});
+  vk::DescriptorSetLayout  descriptorSetLayout = logicalDevice.getDonutDescriptorSetLayout();
+  vk::DescriptorBufferInfo lateLatchedInfo(logicalDevice.getLateLatchedGlobalDataBuffer(), 0, VK_WHOLE_SIZE);
+  for(uint32_t i = 0; i < TriangleMeshInstanceSet::NUM_BUFFERS; ++i)
+  {
+    m_globalDataRanges[i] = logicalDevice.allocateInstanceBufferRange(this->getDeviceIndex(), sizeof(GlobalData));
+    m_globalDataDescriptorSets[i] =
+        logicalDevice.vkDevice().allocateDescriptorSets({m_descriptorPool.get(), descriptorSetLayout})[0];
+    vk::DescriptorBufferInfo globalDataInfo(m_globalDataRanges[i].buffer(), m_globalDataRanges[i].offset(), sizeof(GlobalData));
+    std::vector<vk::WriteDescriptorSet> writes = {
+        {m_globalDataDescriptorSets[i], 0, 0, vk::DescriptorType::eUniformBuffer, {}, globalDataInfo},
+        {m_globalDataDescriptorSets[i], 1, 0, vk::DescriptorType::eUniformBuffer, {}, lateLatchedInfo},
+    };
+    logicalDevice.vkDevice().updateDescriptorSets(writes, {});
+  }
+}
+
+void CanvasRegionRenderThread::updateGlobalData(vk::CommandBuffer transferCmdBuffer, SceneSnapshot const& scene)
+{
+  GlobalData globalData      = {};
+  globalData.m_view          = scene.m_view;
+  globalData.m_proj          = scene.m_proj;
+  globalData.m_runtimeMillis = scene.m_runtimeMillis;
+  // in low-latency mode the shader reads the data latched by the logical device right before the submission instead
+  globalData.m_lateLatchSlot =
+      this->getLogicalDevice().isLowLatencyEnabled() ? this->getLogicalDevice().getCurrentFrameSlot() : NO_LATE_LATCH_SLOT;
+
+  StagingBufferRange staging = this->allocateFrameStagingMemory(sizeof(GlobalData));
+  memcpy(staging.m_mapped, &globalData, sizeof(GlobalData));
+  BufferSuballocator::Range const& globalDataRange = m_globalDataRanges[m_instances->getBufferIndex()];
+  vk::BufferCopy                   copy(staging.m_offset, globalDataRange.offset(), sizeof(GlobalData));
+  transferCmdBuffer.copyBuffer(staging.m_buffer, globalDataRange.buffer(), copy);
+}
+
+void CanvasRegionRenderThread::generateInstances(vk::CommandBuffer computeCmdBuffer, uint32_t numFurLayers)
+{
+  LogicalDevice& logicalDevice = this->getLogicalDevice();
+  vk::DeviceSize nodesSize     = m_nodeTransforms.size() * sizeof(NodeTransform);
+
+  // compute queues support transfers as well, so the node transforms are copied right before they are read
+  StagingBufferRange staging = this->allocateFrameStagingMemory(nodesSize);
+  memcpy(staging.m_mapped, m_nodeTransforms.data(), nodesSize);
+  computeCmdBuffer.copyBuffer(staging.m_buffer, m_nodeRange.buffer(), vk::BufferCopy(staging.m_offset, m_nodeRange.offset(), nodesSize));
+  vk::BufferMemoryBarrier2 copyBarrier(vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+                                       vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead,
+                                       VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_nodeRange.buffer(),
+                                       m_nodeRange.offset(), nodesSize);
+  computeCmdBuffer.pipelineBarrier2({{}, {}, copyBarrier, {}});
+
+  // the instance buffer alternates every frame, so the descriptor set is allocated per frame from a pool which isn't
+  // in use by any queued frame anymore
+  vk::UniqueDescriptorPool& descriptorPool = m_computeDescriptorPools[logicalDevice.getCurrentFrameSlot()];
+  if(!descriptorPool)
+  {
+    vk::DescriptorPoolSize poolSize(vk::DescriptorType::eStorageBuffer, 2);
+    descriptorPool = logicalDevice.vkDevice().createDescriptorPoolUnique({{}, 1, poolSize});
+  }
+  logicalDevice.vkDevice().resetDescriptorPool(descriptorPool.get());
+  vk::DescriptorSetLayout descriptorSetLayout = logicalDevice.getInstanceExpansionDescriptorSetLayout();
+  vk::DescriptorSet descriptorSet = logicalDevice.vkDevice().allocateDescriptorSets({descriptorPool.get(), descriptorSetLayout})[0];
+  vk::DescriptorBufferInfo nodesInfo(m_nodeRange.buffer(), m_nodeRange.offset(), nodesSize);
+  vk::DescriptorBufferInfo instancesInfo(m_instances->getBuffer(), m_instances->getBufferOffset(), m_instances->getBufferSize());
+  std::vector<vk::WriteDescriptorSet> writes = {
+      {descriptorSet, 0, 0, vk::DescriptorType::eStorageBuffer, {}, nodesInfo},
+      {descriptorSet, 1, 0, vk::DescriptorType::eStorageBuffer, {}, instancesInfo},
+  };
+  logicalDevice.vkDevice().updateDescriptorSets(writes, {});
+
+  InstanceExpansionParams params = {(uint32_t)m_nodeTransforms.size(), numFurLayers, MAX_FUR_EXTRUSION};
+  computeCmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, logicalDevice.getInstanceExpansionPipeline());
+  computeCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, logicalDevice.getInstanceExpansionPipelineLayout(),
+                                      0, descriptorSet, {});
+  computeCmdBuffer.pushConstants<InstanceExpansionParams>(logicalDevice.getInstanceExpansionPipelineLayout(),
+                                                          vk::ShaderStageFlagBits::eCompute, 0, params);
+  computeCmdBuffer.dispatch((m_instances->getNumInstances() + 63) / 64, 1, 1);
+}
+
+void CanvasRegionRenderThread::recordRenderCommands(vk::CommandBuffer cmdBuffer, TriangleMesh& donutTriMesh)
+{
+  cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, this->getLogicalDevice().getDonutPipeline());
+  cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->getLogicalDevice().getDonutPipelineLayout(), 0,
+                               m_globalDataDescriptorSets[m_instances->getBufferIndex()], {});
+  cmdBuffer.setViewport(0, m_viewport);
+
+  // vk_ddisplay
+  // one must ensure to only render to the parts of the surface which are covered by the physical device's present
+  // rectangles. the easiest way to do this is by setting up the scissor rectangle(s) appropriately
+  cmdBuffer.setScissor(0, m_renderArea);
+  m_instances->draw(cmdBuffer, donutTriMesh);
+}
+
+vk::CommandBuffer CanvasRegionRenderThread::getCachedRenderCommands(TriangleMesh& donutTriMesh)
+{
+  // vk_ddisplay
+  // the cached render commands only depend on state which rarely changes. the per-frame data is read from the instance
+  // buffer and the global data buffer, so they have to be recorded again only if e.g. the number of instances changed
+  // or the instance buffer or the mesh's buffers (e.g. by defragmentation) have been reallocated. each of the
+  // alternating instance buffers has its own cached commands
+  CachedRenderCommands&     cached     = m_cachedRenderCommands[m_instances->getBufferIndex()];
+  FrameIndex                frameIndex = this->getLogicalDevice().getCurrentFrameIndex();
+  CachedRenderCommands::Key key        = {this->getLogicalDevice().getDonutPipeline(), &donutTriMesh,
+                                          donutTriMesh.getVertexBuffer(), donutTriMesh.getIndexBuffer(),
+                                          m_instances->getBuffer(), m_instances->getBufferOffset(),
+                                          m_instances->getNumInstances()};
+  while(!m_retiredCachedCmdBuffers.empty() && m_retiredCachedCmdBuffers.front().first + this->getLogicalDevice().getNumQueuedFrames() <= frameIndex)
+  {
+    m_retiredCachedCmdBuffers.pop_front();
+  }
+  if(cached.m_cmdBuffer && cached.m_key == key)
+  {
+    cached.m_lastUsedFrameIndex = frameIndex;
+    return cached.m_cmdBuffer.get();
+  }
+
+  // the previous command buffer might still be executed by queued frames
+  if(cached.m_cmdBuffer)
+  {
+    m_retiredCachedCmdBuffers.emplace_back(cached.m_lastUsedFrameIndex, std::move(cached.m_cmdBuffer));
+  }
+  if(!m_cachedCmdPool)
+  {
+    m_cachedCmdPool = this->getLogicalDevice().vkDevice().createCommandPoolUnique(
+        {{}, this->getLogicalDevice().getGraphicsQueueFamilyIndex()});
+  }
+  vk::CommandBufferAllocateInfo allocateInfo(m_cachedCmdPool.get(), vk::CommandBufferLevel::eSecondary, 1);
+  cached.m_cmdBuffer          = std::move(this->getLogicalDevice().vkDevice().allocateCommandBuffersUnique(allocateInfo)[0]);
+  cached.m_key                = key;
+  cached.m_lastUsedFrameIndex = frameIndex;
+
+  // the framebuffer is left unspecified, so the command buffer can be executed with any swap chain image
+  vk::CommandBuffer                cmdBuffer = cached.m_cmdBuffer.get();
+  vk::CommandBufferInheritanceInfo inheritanceInfo(this->getLogicalDevice().getDonutRenderPass(), 0);
+  cmdBuffer.begin({vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse,
+                   &inheritanceInfo});
+  this->recordRenderCommands(cmdBuffer, donutTriMesh);
+  cmdBuffer.end();
+  return cmdBuffer;
 }
 }  // namespace vkdd
\ No newline at end of file
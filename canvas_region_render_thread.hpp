@@ -20,19 +20,31 @@
 #pragma once
 #include "vkdd.hpp"
 
+#include "buffer_suballocator.hpp"
+#include "render_graph.hpp"
 #include "render_thread.hpp"
+#include "triangle_mesh_instance_set.hpp"
+
+#include <deque>
 
 namespace vkdd {
+// vk_ddisplay
+// a canvas region render thread renders the scene into the render area of one device on a logical display
+// its render commands can be cached in a secondary command buffer, which is reused as long as the pipeline, the triangle
+// mesh and its buffers, and the instance buffer range stay the same. the per-frame data is read from buffers instead
+// the instances and the global data are double-buffered, so that their upload overlaps with the previous frame's
+// rendering which reads the other buffers. with async compute, only the node transforms are uploaded and the instances
+// are generated on the compute queue
 class CanvasRegionRenderThread : public RenderThread
 {
 public:
-  CanvasRegionRenderThread(class Scene const&   scene,
-                           class LogicalDevice& logicalDevice,
-                           DeviceIndex          deviceIndex,
-                           vk::Rect2D           renderArea,
-                           vk::Viewport         viewport);
+  CanvasRegionRenderThread(class LogicalDevice& logicalDevice, DeviceIndex deviceIndex, vk::Rect2D renderArea, vk::Viewport viewport);
 
-  void     recordCommands(class CommandExecutionUnit& cmdExecUnit, vk::Framebuffer framebuffer) override;
+  void recordCommands(class CommandExecutionUnit& cmdExecUnit, struct SceneSnapshot const& scene, vk::Framebuffer framebuffer, bool useSecondaryCmdBuffer) override;
+  void resizeFrameRings() override;
+  // the secondary command buffer recorded in the last frame, if any
+  vk::CommandBuffer getSecondaryCommandBuffer() const { return m_secondaryCmdBuffer; }
+  vk::Rect2D        getRenderArea() const { return m_renderArea; }
   void     incNumFurLayers() { ++m_numFurLayers; }
   void     decNumFurLayers() { m_numFurLayers = std::max(1, m_numFurLayers - 1); }
   int32_t& getNumFurLayers() { return m_numFurLayers; }
@@ -40,14 +52,62 @@ public:
   Vec3f    getLastClearColor() const { return m_lastClearColor; }
 
 private:
-  Scene const&                                   m_scene;
-  vk::Rect2D                                     m_renderArea;
-  vk::Viewport                                   m_viewport;
-  int32_t                                        m_numFurLayers = 32;
-  std::unique_ptr<class TriangleMeshInstanceSet> m_instances;
-  vk::UniqueSemaphore                            m_syncTimelineSemaphore;
-  uint64_t                                       m_syncTimelineSemaphoreValue;
-  bool                                           m_highlighted;
-  Vec3f                                          m_lastClearColor;
+  struct CachedRenderCommands
+  {
+    struct Key
+    {
+      vk::Pipeline              m_pipeline;
+      class TriangleMesh const* m_triMesh;
+      // the mesh's buffers are baked into the commands and change when the mesh gets relocated by defragmentation
+      vk::Buffer                m_vertexBuffer;
+      vk::Buffer                m_indexBuffer;
+      vk::Buffer                m_instanceBuffer;
+      vk::DeviceSize            m_instanceBufferOffset;
+      uint32_t                  m_numInstances;
+
+      bool operator==(Key const& other) const
+      {
+        return m_pipeline == other.m_pipeline && m_triMesh == other.m_triMesh && m_vertexBuffer == other.m_vertexBuffer
+               && m_indexBuffer == other.m_indexBuffer && m_instanceBuffer == other.m_instanceBuffer
+               && m_instanceBufferOffset == other.m_instanceBufferOffset && m_numInstances == other.m_numInstances;
+      }
+    };
+
+    Key                     m_key;
+    vk::UniqueCommandBuffer m_cmdBuffer;
+    FrameIndex              m_lastUsedFrameIndex;
+  };
+
+  vk::Rect2D                                                                    m_renderArea;
+  vk::Viewport                                                                  m_viewport;
+  int32_t                                                                       m_numFurLayers = 32;
+  std::unique_ptr<class TriangleMeshInstanceSet>                                m_instances;
+  bool                                                                          m_highlighted;
+  RenderGraph                                                                   m_renderGraph;
+  // one resource per instance and global data buffer, so that their access states don't get dropped when the buffers
+  // alternate
+  std::array<RenderGraph::BufferResource, TriangleMeshInstanceSet::NUM_BUFFERS> m_instanceResources;
+  std::array<RenderGraph::BufferResource, TriangleMeshInstanceSet::NUM_BUFFERS> m_globalDataResources;
+  Vec3f                                                                         m_lastClearColor;
+  vk::CommandBuffer                                                             m_secondaryCmdBuffer;
+  std::array<BufferSuballocator::Range, TriangleMeshInstanceSet::NUM_BUFFERS>   m_globalDataRanges;
+  vk::UniqueDescriptorPool                                                      m_descriptorPool;
+  std::array<vk::DescriptorSet, TriangleMeshInstanceSet::NUM_BUFFERS>           m_globalDataDescriptorSets;
+  vk::UniqueCommandPool                                                         m_cachedCmdPool;
+  std::array<CachedRenderCommands, TriangleMeshInstanceSet::NUM_BUFFERS>        m_cachedRenderCommands;
+  // instance generation on the async compute queue
+  std::vector<NodeTransform>                              m_nodeTransforms;
+  BufferSuballocator::Range                               m_nodeRange;
+  uint32_t                                                m_nodeCapacity;
+  RenderGraph::BufferResource                             m_nodeResource;
+  std::array<vk::UniqueDescriptorPool, MAX_QUEUED_FRAMES> m_computeDescriptorPools;
+  // cached command buffers which have been replaced, with the frame index they were last used in
+  std::deque<std::pair<FrameIndex, vk::UniqueCommandBuffer>> m_retiredCachedCmdBuffers;
+
+  void              prepareGlobalData();
+  void              updateGlobalData(vk::CommandBuffer transferCmdBuffer, SceneSnapshot const& scene);
+  void              generateInstances(vk::CommandBuffer computeCmdBuffer, uint32_t numFurLayers);
+  void              recordRenderCommands(vk::CommandBuffer cmdBuffer, class TriangleMesh& donutTriMesh);
+  vk::CommandBuffer getCachedRenderCommands(TriangleMesh& donutTriMesh);
 };
 }  // namespace vkdd
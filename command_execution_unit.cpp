@@ -22,58 +22,147 @@
 #include "logical_device.hpp"
 
 namespace vkdd {
+// command buffers are allocated in chunks of this size when a pool runs out of them
+static constexpr uint32_t COMMAND_BUFFER_CHUNK_SIZE = 8;
+
 struct CommandBufferPool
 {
   vk::UniqueCommandPool                m_commandPool;
   std::vector<vk::UniqueCommandBuffer> m_commandBuffers;
   uint32_t                             m_nextCommandBufferIndex;
-};
-
-struct QueueFamilyIndexData
-{
-  vk::UniqueFence                                        m_syncFence;
-  std::unordered_map<std::thread::id, CommandBufferPool> m_perThreadCommandBufferPools;
+  std::vector<vk::UniqueCommandBuffer> m_secondaryCommandBuffers;
+  uint32_t                             m_nextSecondaryCommandBufferIndex;
 };
 
 struct CommandBufferInfo
 {
+  uint64_t                             m_sequenceNumber;
+  uint32_t                             m_queueFamilyIndex;
   vk::CommandBufferSubmitInfo          m_commandBufferInfo;
   std::vector<vk::SemaphoreSubmitInfo> m_waitSemaphoreInfos;
   std::vector<vk::SemaphoreSubmitInfo> m_signalSemaphoreInfos;
 };
 
+// a slot is only ever touched by its recording thread, except in waitForIdleAndReset() and submit() which are called
+// while no thread is recording
+// secondary command buffers are never submitted, their semaphores are moved to the primary command buffer executing them
+// only the pools which handed out command buffers in this frame are reset, they are collected in m_usedPools
+struct RecordingSlot
+{
+  std::unordered_map<uint32_t, CommandBufferPool> m_commandBufferPools;
+  std::vector<CommandBufferPool*>                 m_usedPools;
+  std::vector<CommandBufferInfo>                  m_commandBufferInfos;
+  std::vector<CommandBufferInfo>                  m_secondaryCommandBufferInfos;
+};
+
+// command buffers of a single queue which are submitted with one SubmitInfo2
+struct SubmitBatch
+{
+  uint32_t                                 m_queueFamilyIndex;
+  uint64_t                                 m_sequenceNumber;
+  std::vector<vk::SemaphoreSubmitInfo>     m_waitSemaphoreInfos;
+  std::vector<vk::CommandBufferSubmitInfo> m_commandBufferInfos;
+  std::vector<vk::SemaphoreSubmitInfo>     m_signalSemaphoreInfos;
+  uint32_t                                 m_numDependencies;
+  std::vector<size_t>                      m_dependents;
+};
+
+// the timeline semaphores signaled by the last batch of a non-graphics queue in each frame, one per physical device
+struct QueueCompletion
+{
+  std::vector<vk::UniqueSemaphore> m_semaphores;
+  uint64_t                         m_value;
+};
+
+static thread_local RecordingSlotIndex t_recordingSlotIndex = 0;
+
+static CommandBufferInfo* findInfo(std::vector<CommandBufferInfo>& infos, vk::CommandBuffer cmdBuffer)
+{
+  // semaphores are usually pushed right after requesting the command buffer, so the search starts at the back
+  for(auto it = infos.rbegin(); it != infos.rend(); ++it)
+  {
+    if(it->m_commandBufferInfo.commandBuffer == cmdBuffer)
+    {
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
 CommandExecutionUnit::CommandExecutionUnit(LogicalDevice& logicalDevice)
     : m_logicalDevice(logicalDevice)
+    , m_recordingSlots(1)
+    , m_nextSequenceNumber(0)
+    , m_completionValue(0)
 {
 }
 
 CommandExecutionUnit::~CommandExecutionUnit() {}
 
-vk::Result CommandExecutionUnit::waitForIdle()
+RecordingSlotIndex CommandExecutionUnit::bindRecordingSlot(RecordingSlotIndex slotIndex)
+{
+  return std::exchange(t_recordingSlotIndex, slotIndex);
+}
+
+RecordingSlot& CommandExecutionUnit::getRecordingSlot()
+{
+  assert(t_recordingSlotIndex < m_recordingSlots.size());
+  return m_recordingSlots[t_recordingSlotIndex];
+}
+
+QueueCompletion& CommandExecutionUnit::getQueueCompletion(uint32_t queueFamilyIndex)
 {
-  std::vector<vk::Fence> fences;
-  for(auto const& it : m_library)
+  QueueCompletion& completion = m_queueCompletions[queueFamilyIndex];
+  if(completion.m_semaphores.empty())
   {
-    fences.emplace_back(it.second.m_syncFence.get());
+    vk::SemaphoreTypeCreateInfo semType(vk::SemaphoreType::eTimeline, 0);
+    for(DeviceIndex deviceIndex = 0; deviceIndex < m_logicalDevice.getNumPhysicalDevices(); ++deviceIndex)
+    {
+      completion.m_semaphores.emplace_back(m_logicalDevice.vkDevice().createSemaphoreUnique({{}, &semType}));
+    }
+    completion.m_value = 0;
   }
-  if(fences.empty())
+  return completion;
+}
+
+vk::Result CommandExecutionUnit::waitForIdle()
+{
+  if(m_completionValue == 0)
   {
     return vk::Result::eSuccess;
   }
-  vk::Result result = m_logicalDevice.vkDevice().waitForFences(fences, true, std::numeric_limits<uint64_t>::max());
-  m_logicalDevice.vkDevice().resetFences(fences);
-  return result;
+  // the frame is only done once every physical device reached its value
+  std::vector<vk::Semaphore> frameTimelineSems;
+  for(DeviceIndex deviceIndex = 0; deviceIndex < m_logicalDevice.getNumPhysicalDevices(); ++deviceIndex)
+  {
+    frameTimelineSems.emplace_back(m_logicalDevice.getFrameTimelineSemaphore(deviceIndex));
+  }
+  std::vector<uint64_t> values(frameTimelineSems.size(), m_completionValue);
+  return m_logicalDevice.vkDevice().waitSemaphores({{}, frameTimelineSems, values}, std::numeric_limits<uint64_t>::max());
 }
 
-void CommandExecutionUnit::waitForIdleAndReset()
+bool CommandExecutionUnit::isIdle(uint64_t frameTimelineValue) const
+{
+  return m_completionValue <= frameTimelineValue;
+}
+
+void CommandExecutionUnit::waitForIdleAndReset(RecordingSlotIndex numRecordingSlots)
 {
   this->waitForIdle();
-  for(auto const& queueIt : m_library)
+  for(RecordingSlot& slot : m_recordingSlots)
   {
-    for(auto const& threadIt : queueIt.second.m_perThreadCommandBufferPools)
+    for(CommandBufferPool* cbp : slot.m_usedPools)
     {
-      m_logicalDevice.vkDevice().resetCommandPool(threadIt.second.m_commandPool.get());
+      m_logicalDevice.vkDevice().resetCommandPool(cbp->m_commandPool.get());
+      cbp->m_nextCommandBufferIndex          = 0;
+      cbp->m_nextSecondaryCommandBufferIndex = 0;
     }
+    slot.m_usedPools.clear();
+  }
+  // the slots are only moved while none of their command buffers is in use, the pools are kept by their maps' nodes
+  if(m_recordingSlots.size() < numRecordingSlots)
+  {
+    m_recordingSlots.resize(numRecordingSlots);
   }
 }
 
@@ -81,64 +170,124 @@ std::vector<vk::CommandBuffer> CommandExecutionUnit::requestCommandBuffers(std::
                                                                            std::optional<DeviceMask> deviceMask)
 {
   std::vector<vk::CommandBuffer> cmdBuffers;
-  if(!queueFamilyIndices.empty())
+  for(uint32_t queueFamilyIndex : queueFamilyIndices)
   {
-    std::lock_guard guard(m_mutex);
-    for(uint32_t queueFamilyIndex : queueFamilyIndices)
-    {
-      cmdBuffers.emplace_back(this->requestCommandBufferUnguarded(queueFamilyIndex, deviceMask));
-    }
+    cmdBuffers.emplace_back(this->requestCommandBuffer(queueFamilyIndex, deviceMask));
   }
   return cmdBuffers;
 }
+
+CommandBufferPool& CommandExecutionUnit::getCommandBufferPool(uint32_t queueFamilyIndex)
+{
+  RecordingSlot&     slot = this->getRecordingSlot();
+  CommandBufferPool& cbp  = slot.m_commandBufferPools[queueFamilyIndex];
+  if(!cbp.m_commandPool)
+  {
+    cbp = {m_logicalDevice.vkDevice().createCommandPoolUnique({{}, queueFamilyIndex}), {}, 0, {}, 0};
+  }
+  if(cbp.m_nextCommandBufferIndex == 0 && cbp.m_nextSecondaryCommandBufferIndex == 0)
+  {
+    slot.m_usedPools.emplace_back(&cbp);
+  }
+  return cbp;
+}
+
+void CommandExecutionUnit::allocateCommandBufferChunk(CommandBufferPool&                    cbp,
+                                                      vk::CommandBufferLevel                level,
+                                                      std::vector<vk::UniqueCommandBuffer>& cmdBuffers)
+{
+  vk::CommandBufferAllocateInfo commandBufferAllocateInfo(cbp.m_commandPool.get(), level, COMMAND_BUFFER_CHUNK_SIZE);
+  for(vk::UniqueCommandBuffer& cmdBuffer : m_logicalDevice.vkDevice().allocateCommandBuffersUnique(commandBufferAllocateInfo))
+  {
+    cmdBuffers.emplace_back(std::move(cmdBuffer));
+  }
+}
+
 vk::CommandBuffer CommandExecutionUnit::requestCommandBuffer(uint32_t queueFamilyIndex, std::optional<DeviceMask> deviceMask)
 {
-  std::lock_guard guard(m_mutex);
-  return this->requestCommandBufferUnguarded(queueFamilyIndex, deviceMask);
+  RecordingSlot&     slot = this->getRecordingSlot();
+  CommandBufferPool& cbp  = this->getCommandBufferPool(queueFamilyIndex);
+  if(cbp.m_commandBuffers.size() <= cbp.m_nextCommandBufferIndex)
+  {
+    this->allocateCommandBufferChunk(cbp, vk::CommandBufferLevel::ePrimary, cbp.m_commandBuffers);
+  }
+  vk::CommandBuffer cmdBuffer = cbp.m_commandBuffers[cbp.m_nextCommandBufferIndex++].get();
+  // the sequence number keeps the submission order of the command buffers of all slots in the order of their requests
+  slot.m_commandBufferInfos.push_back({m_nextSequenceNumber.fetch_add(1, std::memory_order_relaxed), queueFamilyIndex,
+                                       {cmdBuffer, deviceMask.value_or(DeviceMask())}, {}, {}});
+  return cmdBuffer;
+}
+
+vk::CommandBuffer CommandExecutionUnit::requestSecondaryCommandBuffer(uint32_t queueFamilyIndex)
+{
+  CommandBufferPool& cbp = this->getCommandBufferPool(queueFamilyIndex);
+  if(cbp.m_secondaryCommandBuffers.size() <= cbp.m_nextSecondaryCommandBufferIndex)
+  {
+    this->allocateCommandBufferChunk(cbp, vk::CommandBufferLevel::eSecondary, cbp.m_secondaryCommandBuffers);
+  }
+  vk::CommandBuffer cmdBuffer = cbp.m_secondaryCommandBuffers[cbp.m_nextSecondaryCommandBufferIndex++].get();
+  this->registerSecondaryCommandBuffer(cmdBuffer, queueFamilyIndex);
+  return cmdBuffer;
+}
+
+void CommandExecutionUnit::registerSecondaryCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t queueFamilyIndex)
+{
+  this->getRecordingSlot().m_secondaryCommandBufferInfos.push_back({0, queueFamilyIndex, {cmdBuffer}, {}, {}});
 }
 
-vk::CommandBuffer CommandExecutionUnit::requestCommandBufferUnguarded(uint32_t queueFamilyIndex, std::optional<DeviceMask> deviceMask)
+void CommandExecutionUnit::executeCommands(vk::CommandBuffer primaryCmdBuffer, std::vector<vk::CommandBuffer> const& secondaryCmdBuffers)
 {
-  CommandBufferPool* cbp = nullptr;
-  if(auto findQueueIt = m_library.find(queueFamilyIndex); findQueueIt != m_library.end())
+  // vk_ddisplay
+  // the secondary command buffers may have been recorded by any thread, this is fine since all of them finished
+  // recording before their primary command buffer is recorded
+  CommandBufferInfo* primaryInfo = this->findCommandBufferInfo(primaryCmdBuffer);
+  for(vk::CommandBuffer secondaryCmdBuffer : secondaryCmdBuffers)
   {
-    if(auto findThreadIt = findQueueIt->second.m_perThreadCommandBufferPools.find(std::this_thread::get_id());
-       findThreadIt != findQueueIt->second.m_perThreadCommandBufferPools.end())
+    for(RecordingSlot& slot : m_recordingSlots)
     {
-      cbp = &findThreadIt->second;
+      if(CommandBufferInfo* secondaryInfo = findInfo(slot.m_secondaryCommandBufferInfos, secondaryCmdBuffer))
+      {
+        if(primaryInfo)
+        {
+          primaryInfo->m_waitSemaphoreInfos.insert(primaryInfo->m_waitSemaphoreInfos.end(),
+                                                   secondaryInfo->m_waitSemaphoreInfos.begin(),
+                                                   secondaryInfo->m_waitSemaphoreInfos.end());
+          primaryInfo->m_signalSemaphoreInfos.insert(primaryInfo->m_signalSemaphoreInfos.end(),
+                                                     secondaryInfo->m_signalSemaphoreInfos.begin(),
+                                                     secondaryInfo->m_signalSemaphoreInfos.end());
+        }
+        secondaryInfo->m_waitSemaphoreInfos.clear();
+        secondaryInfo->m_signalSemaphoreInfos.clear();
+        break;
+      }
     }
   }
-  if(!cbp)
+  primaryCmdBuffer.executeCommands(secondaryCmdBuffers);
+}
+
+CommandBufferInfo* CommandExecutionUnit::findCommandBufferInfo(vk::CommandBuffer cmdBuffer)
+{
+  RecordingSlot&     slot = this->getRecordingSlot();
+  CommandBufferInfo* info = findInfo(slot.m_commandBufferInfos, cmdBuffer);
+  if(!info)
   {
-    m_library[queueFamilyIndex].m_syncFence = m_logicalDevice.vkDevice().createFenceUnique({});
-    cbp = &(m_library[queueFamilyIndex].m_perThreadCommandBufferPools[std::this_thread::get_id()] = {
-                m_logicalDevice.vkDevice().createCommandPoolUnique({{}, queueFamilyIndex})});
+    info = findInfo(slot.m_secondaryCommandBufferInfos, cmdBuffer);
   }
-  if(cbp->m_commandBuffers.size() <= cbp->m_nextCommandBufferIndex)
+  if(!info)
   {
-    vk::CommandBufferAllocateInfo graphicsCommandBufferAllocateInfo(cbp->m_commandPool.get(), vk::CommandBufferLevel::ePrimary, 1);
-    cbp->m_commandBuffers.emplace_back(
-        std::move(m_logicalDevice.vkDevice().allocateCommandBuffersUnique(graphicsCommandBufferAllocateInfo)[0]));
+    LOGE("Unknown command buffer given.\n");
   }
-  vk::CommandBuffer cmdBuffer     = cbp->m_commandBuffers[cbp->m_nextCommandBufferIndex++].get();
-  m_commandBufferInfos[cmdBuffer] = {{cmdBuffer, deviceMask.value_or(DeviceMask())}, {}, {}};
-  m_submitOrder[queueFamilyIndex].emplace_back(cmdBuffer);
-  return cmdBuffer;
+  return info;
 }
 
 void CommandExecutionUnit::pushWaits(vk::CommandBuffer cmdBuffer, std::vector<vk::SemaphoreSubmitInfo> const& waitSemaphoreInfos)
 {
   if(!waitSemaphoreInfos.empty())
   {
-    std::lock_guard guard(m_mutex);
-    auto            findIt = m_commandBufferInfos.find(cmdBuffer);
-    if(findIt == m_commandBufferInfos.end())
+    if(CommandBufferInfo* info = this->findCommandBufferInfo(cmdBuffer))
     {
-      LOGE("Unknown command buffer given.\n");
-      return;
+      info->m_waitSemaphoreInfos.insert(info->m_waitSemaphoreInfos.end(), waitSemaphoreInfos.begin(), waitSemaphoreInfos.end());
     }
-    findIt->second.m_waitSemaphoreInfos.insert(findIt->second.m_waitSemaphoreInfos.end(), waitSemaphoreInfos.begin(),
-                                               waitSemaphoreInfos.end());
   }
 }
 
@@ -151,15 +300,11 @@ void CommandExecutionUnit::pushSignals(vk::CommandBuffer cmdBuffer, std::vector<
 {
   if(!signalSemaphoreInfos.empty())
   {
-    std::lock_guard guard(m_mutex);
-    auto            findIt = m_commandBufferInfos.find(cmdBuffer);
-    if(findIt == m_commandBufferInfos.end())
+    if(CommandBufferInfo* info = this->findCommandBufferInfo(cmdBuffer))
     {
-      LOGE("Unknown command buffer given.\n");
-      return;
+      info->m_signalSemaphoreInfos.insert(info->m_signalSemaphoreInfos.end(), signalSemaphoreInfos.begin(),
+                                          signalSemaphoreInfos.end());
     }
-    findIt->second.m_signalSemaphoreInfos.insert(findIt->second.m_signalSemaphoreInfos.end(),
-                                                 signalSemaphoreInfos.begin(), signalSemaphoreInfos.end());
   }
 }
 
@@ -170,25 +315,174 @@ void CommandExecutionUnit::pushSignal(vk::CommandBuffer cmdBuffer, vk::Semaphore
 
 void CommandExecutionUnit::submit()
 {
-  for(auto const& it : m_submitOrder)
+  std::vector<CommandBufferInfo const*> infos;
+  for(RecordingSlot const& slot : m_recordingSlots)
+  {
+    for(CommandBufferInfo const& info : slot.m_commandBufferInfos)
+    {
+      infos.emplace_back(&info);
+    }
+  }
+  std::sort(infos.begin(), infos.end(), [](CommandBufferInfo const* left, CommandBufferInfo const* right) {
+    return left->m_sequenceNumber < right->m_sequenceNumber;
+  });
+
+  // consecutive command buffers of a queue are merged into a single batch as long as there is no semaphore in between
+  std::vector<SubmitBatch>             batches;
+  std::unordered_map<uint32_t, size_t> lastBatchOfQueue;
+  for(CommandBufferInfo const* info : infos)
+  {
+    auto lastIt = lastBatchOfQueue.find(info->m_queueFamilyIndex);
+    if(lastIt != lastBatchOfQueue.end() && batches[lastIt->second].m_signalSemaphoreInfos.empty()
+       && info->m_waitSemaphoreInfos.empty())
+    {
+      SubmitBatch& batch = batches[lastIt->second];
+      batch.m_commandBufferInfos.emplace_back(info->m_commandBufferInfo);
+      batch.m_signalSemaphoreInfos = info->m_signalSemaphoreInfos;
+      continue;
+    }
+    SubmitBatch& batch           = batches.emplace_back();
+    batch.m_queueFamilyIndex     = info->m_queueFamilyIndex;
+    batch.m_sequenceNumber       = info->m_sequenceNumber;
+    batch.m_waitSemaphoreInfos   = info->m_waitSemaphoreInfos;
+    batch.m_commandBufferInfos   = {info->m_commandBufferInfo};
+    batch.m_signalSemaphoreInfos = info->m_signalSemaphoreInfos;
+    batch.m_numDependencies      = 0;
+    if(lastIt != lastBatchOfQueue.end())
+    {
+      batches[lastIt->second].m_dependents.emplace_back(batches.size() - 1);
+      ++batch.m_numDependencies;
+    }
+    lastBatchOfQueue[info->m_queueFamilyIndex] = batches.size() - 1;
+  }
+
+  // a batch waiting on a semaphore depends on the batch signaling it in this frame, timeline semaphores have to match
+  // the value as well
+  for(size_t waitIdx = 0; waitIdx < batches.size(); ++waitIdx)
+  {
+    for(vk::SemaphoreSubmitInfo const& wait : batches[waitIdx].m_waitSemaphoreInfos)
+    {
+      for(size_t signalIdx = 0; signalIdx < batches.size(); ++signalIdx)
+      {
+        for(vk::SemaphoreSubmitInfo const& signal : batches[signalIdx].m_signalSemaphoreInfos)
+        {
+          if(signalIdx != waitIdx && signal.semaphore == wait.semaphore && signal.value == wait.value)
+          {
+            batches[signalIdx].m_dependents.emplace_back(waitIdx);
+            ++batches[waitIdx].m_numDependencies;
+          }
+        }
+      }
+    }
+  }
+
+  // vk_ddisplay
+  // the batches are submitted in topological order, preferring transfer work so that uploads can start as early as
+  // possible and the graphics queue doesn't wait for them
+  std::vector<size_t> order;
+  std::vector<bool>   scheduled(batches.size(), false);
+  uint32_t            graphicsQueueFamilyIndex = m_logicalDevice.getGraphicsQueueFamilyIndex();
+  while(order.size() < batches.size())
   {
-    vk::Queue queue = m_logicalDevice.getQueue(it.first);
-    // for(uint32_t i = 0; i < it.second.size(); ++i)
-    // {
-    //   CommandBufferInfo const& info = m_commandBufferInfos[it.second[i]];
-    //   vk::SubmitInfo2 submit({}, info.m_waitSemaphoreInfos, info.m_commandBufferInfo, info.m_signalSemaphoreInfos);
-    //   LOGI("%d\n", i);
-    //   queue.submit2(submit, it.first == m_syncFenceQueueFamilyIndex && i == it.second.size() - 1 ? m_syncFence.get() : nullptr);
-    // }
-    std::vector<vk::SubmitInfo2> submits;
-    for(vk::CommandBuffer cmdBuffer : it.second)
+    std::optional<size_t> nextIdx;
+    for(size_t i = 0; i < batches.size(); ++i)
+    {
+      if(scheduled[i] || batches[i].m_numDependencies != 0)
+      {
+        continue;
+      }
+      bool isTransfer     = batches[i].m_queueFamilyIndex != graphicsQueueFamilyIndex;
+      bool nextIsTransfer = nextIdx.has_value() && batches[nextIdx.value()].m_queueFamilyIndex != graphicsQueueFamilyIndex;
+      if(!nextIdx.has_value() || (isTransfer && !nextIsTransfer)
+         || (isTransfer == nextIsTransfer && batches[i].m_sequenceNumber < batches[nextIdx.value()].m_sequenceNumber))
+      {
+        nextIdx = i;
+      }
+    }
+    if(!nextIdx.has_value())
     {
-      CommandBufferInfo const& info = m_commandBufferInfos[cmdBuffer];
-      submits.emplace_back(vk::SubmitInfo2({}, info.m_waitSemaphoreInfos, info.m_commandBufferInfo, info.m_signalSemaphoreInfos));
+      // a cycle can only be caused by inconsistent semaphore usage, the remaining batches keep their request order
+      LOGE("Cyclic semaphore dependencies between command buffers.\n");
+      for(size_t i = 0; i < batches.size(); ++i)
+      {
+        if(!scheduled[i])
+        {
+          order.emplace_back(i);
+        }
+      }
+      break;
     }
-    queue.submit2(submits, m_library[it.first].m_syncFence.get());
+    scheduled[nextIdx.value()] = true;
+    order.emplace_back(nextIdx.value());
+    for(size_t dependentIdx : batches[nextIdx.value()].m_dependents)
+    {
+      --batches[dependentIdx].m_numDependencies;
+    }
+  }
+
+  // vk_ddisplay
+  // the completion of the frame is tracked by the device's frame timeline semaphores, which are only signaled on the
+  // graphics queue, so that their values increase in submission order. the last batch of each other queue signals the
+  // unit's semaphores of that queue instead, and the final graphics submission waits for them. no batch of a frame
+  // waits for the previous frame, so the queues of consecutive frames can overlap
+  // the command buffers of a device group run on single devices, but a semaphore operation only covers the work of the
+  // physical device given by its device index, so every semaphore is signaled and waited for on each physical device
+  if(!order.empty())
+  {
+    // an empty batch submitted after all others carries the frame's signal, so that the waits don't hold back the
+    // commands of the last graphics batch. it is merged into the graphics queue's last submit call
+    batches.push_back({graphicsQueueFamilyIndex, m_nextSequenceNumber, {}, {}, {}, 0, {}});
+    order.emplace_back(batches.size() - 1);
+    SubmitBatch&          finalBatch = batches.back();
+    std::vector<uint32_t> signaledQueueFamilies;
+    for(auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+      SubmitBatch& batch = batches[*it];
+      if(batch.m_queueFamilyIndex == graphicsQueueFamilyIndex
+         || std::find(signaledQueueFamilies.begin(), signaledQueueFamilies.end(), batch.m_queueFamilyIndex)
+                != signaledQueueFamilies.end())
+      {
+        continue;
+      }
+      signaledQueueFamilies.emplace_back(batch.m_queueFamilyIndex);
+      QueueCompletion& completion = this->getQueueCompletion(batch.m_queueFamilyIndex);
+      ++completion.m_value;
+      for(DeviceIndex deviceIndex = 0; deviceIndex < completion.m_semaphores.size(); ++deviceIndex)
+      {
+        vk::Semaphore semaphore = completion.m_semaphores[deviceIndex].get();
+        batch.m_signalSemaphoreInfos.emplace_back(semaphore, completion.m_value, vk::PipelineStageFlagBits2::eAllCommands,
+                                                  deviceIndex);
+        finalBatch.m_waitSemaphoreInfos.emplace_back(semaphore, completion.m_value,
+                                                     vk::PipelineStageFlagBits2::eAllCommands, deviceIndex);
+      }
+    }
+    m_completionValue = m_logicalDevice.advanceFrameTimelineValue();
+    for(DeviceIndex deviceIndex = 0; deviceIndex < m_logicalDevice.getNumPhysicalDevices(); ++deviceIndex)
+    {
+      vk::Semaphore frameTimelineSem = m_logicalDevice.getFrameTimelineSemaphore(deviceIndex);
+      finalBatch.m_signalSemaphoreInfos.emplace_back(frameTimelineSem, m_completionValue,
+                                                     vk::PipelineStageFlagBits2::eAllCommands, deviceIndex);
+    }
+  }
+
+  // consecutive batches of the same queue are submitted with a single call
+  std::vector<vk::SubmitInfo2> submits;
+  for(size_t i = 0; i < order.size(); ++i)
+  {
+    SubmitBatch const& batch = batches[order[i]];
+    submits.emplace_back(vk::SubmitInfo2({}, batch.m_waitSemaphoreInfos, batch.m_commandBufferInfos, batch.m_signalSemaphoreInfos));
+    if(i + 1 == order.size() || batches[order[i + 1]].m_queueFamilyIndex != batch.m_queueFamilyIndex)
+    {
+      m_logicalDevice.getQueue(batch.m_queueFamilyIndex).submit2(submits);
+      submits.clear();
+    }
+  }
+
+  for(RecordingSlot& slot : m_recordingSlots)
+  {
+    slot.m_commandBufferInfos.clear();
+    slot.m_secondaryCommandBufferInfos.clear();
   }
-  m_submitOrder.clear();
-  m_commandBufferInfos.clear();
+  m_nextSequenceNumber = 0;
 }
 }  // namespace vkdd
@@ -20,18 +20,47 @@
 #pragma once
 #include "vkdd.hpp"
 
+#include <atomic>
+
 namespace vkdd {
+typedef uint32_t RecordingSlotIndex;
+
+// vk_ddisplay
+// a command execution unit collects the command buffers of one frame and submits them at once
+// every recording thread owns a slot with its own command pools and submit infos, so that command buffers can be
+// requested and semaphores can be pushed without any locking; the slots are merged in submit()
+// threads which never bind a slot use slot 0, which is reserved for the main thread. the slot of a finished thread,
+// including its command pools, is handed to the next registered thread. slots for new threads are added when the unit
+// is reset at the start of a frame
+// secondary command buffers carry their semaphores until executeCommands() moves them to the executing primary command
+// buffer
+// instead of fences, the submitted frame signals the logical device's frame timeline semaphores on the graphics queue
+// after the frame's work on all queues and physical devices, the unit is idle once all of them reached its completion
+// value
 class CommandExecutionUnit
 {
 public:
   CommandExecutionUnit(class LogicalDevice& logicalDevice);
   ~CommandExecutionUnit();
 
+  // returns the previously bound slot, so that a task running on a borrowed thread can restore it
+  static RecordingSlotIndex bindRecordingSlot(RecordingSlotIndex slotIndex);
+
   vk::Result        waitForIdle();
-  void              waitForIdleAndReset();
+  // the frame timeline value has to be the one completed by all physical devices
+  bool              isIdle(uint64_t frameTimelineValue) const;
+  // the frame timeline value signaled by the last submit()
+  uint64_t          getCompletionValue() const { return m_completionValue; }
+  // grows the slots to the number of registered recording threads, no thread may be recording meanwhile
+  void              waitForIdleAndReset(RecordingSlotIndex numRecordingSlots);
   vk::CommandBuffer requestCommandBuffer(uint32_t queueFamilyIndex, std::optional<DeviceMask> deviceMask = {});
   std::vector<vk::CommandBuffer> requestCommandBuffers(std::vector<uint32_t>     queueFamilyIndices,
                                                        std::optional<DeviceMask> deviceMask = {});
+  vk::CommandBuffer              requestSecondaryCommandBuffer(uint32_t queueFamilyIndex);
+  // makes a secondary command buffer which isn't owned by this unit, e.g. a cached one, known for this frame, so that
+  // semaphores can be pushed to it
+  void registerSecondaryCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t queueFamilyIndex);
+  void executeCommands(vk::CommandBuffer primaryCmdBuffer, std::vector<vk::CommandBuffer> const& secondaryCmdBuffers);
   void                           pushWait(vk::CommandBuffer cmdBuffer, vk::SemaphoreSubmitInfo waitSemaphoreInfo);
   void                           pushSignal(vk::CommandBuffer cmdBuffer, vk::SemaphoreSubmitInfo signalSemaphoreInfo);
   void pushWaits(vk::CommandBuffer cmdBuffer, std::vector<vk::SemaphoreSubmitInfo> const& waitSemaphoreInfos);
@@ -39,12 +68,18 @@ public:
   void submit();
 
 private:
-  LogicalDevice&                                                m_logicalDevice;
-  std::mutex                                                    m_mutex;
-  std::unordered_map<uint32_t, struct QueueFamilyIndexData>     m_library;
-  std::unordered_map<VkCommandBuffer, struct CommandBufferInfo> m_commandBufferInfos;
-  std::unordered_map<uint32_t, std::vector<vk::CommandBuffer>>  m_submitOrder;
+  LogicalDevice&                    m_logicalDevice;
+  std::vector<struct RecordingSlot> m_recordingSlots;
+  std::atomic<uint64_t>             m_nextSequenceNumber;
+  uint64_t                          m_completionValue;
+  std::unordered_map<uint32_t, struct QueueCompletion> m_queueCompletions;
 
-  vk::CommandBuffer requestCommandBufferUnguarded(uint32_t queueFamilyIndex, std::optional<DeviceMask> deviceMask = {});
+  struct RecordingSlot&     getRecordingSlot();
+  struct QueueCompletion&   getQueueCompletion(uint32_t queueFamilyIndex);
+  struct CommandBufferPool& getCommandBufferPool(uint32_t queueFamilyIndex);
+  void                      allocateCommandBufferChunk(struct CommandBufferPool&             cbp,
+                                                       vk::CommandBufferLevel                level,
+                                                       std::vector<vk::UniqueCommandBuffer>& cmdBuffers);
+  struct CommandBufferInfo* findCommandBufferInfo(vk::CommandBuffer cmdBuffer);
 };
 }  // namespace vkdd
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "cpu_topology.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <initguid.h>
+#include <devguid.h>
+#include <devpkey.h>
+#include <setupapi.h>
+#include <algorithm>
+#pragma comment(lib, "setupapi.lib")
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <sstream>
+#endif
+
+namespace vkdd {
+#if defined(_WIN32)
+std::optional<uint32_t> getNumaNodeOfPciDevice(PciAddress const& address)
+{
+  // the display adapters are matched by their bus number and address, the PCI domain isn't exposed by SetupAPI
+  HDEVINFO devInfos = SetupDiGetClassDevsW(&GUID_DEVCLASS_DISPLAY, nullptr, nullptr, DIGCF_PRESENT);
+  if(devInfos == INVALID_HANDLE_VALUE)
+  {
+    return {};
+  }
+  std::optional<uint32_t> numaNode;
+  SP_DEVINFO_DATA         devInfo{sizeof(SP_DEVINFO_DATA)};
+  for(DWORD i = 0; SetupDiEnumDeviceInfo(devInfos, i, &devInfo) && !numaNode.has_value(); ++i)
+  {
+    DWORD bus     = 0;
+    DWORD devAddr = 0;
+    if(!SetupDiGetDeviceRegistryPropertyW(devInfos, &devInfo, SPDRP_BUSNUMBER, nullptr, (PBYTE)&bus, sizeof(bus), nullptr)
+       || !SetupDiGetDeviceRegistryPropertyW(devInfos, &devInfo, SPDRP_ADDRESS, nullptr, (PBYTE)&devAddr, sizeof(devAddr), nullptr))
+    {
+      continue;
+    }
+    if(bus != address.m_bus || devAddr != ((address.m_device << 16) | address.m_function))
+    {
+      continue;
+    }
+    DEVPROPTYPE propType = 0;
+    ULONG       node     = 0;
+    if(SetupDiGetDevicePropertyW(devInfos, &devInfo, &DEVPKEY_Device_Numa_Node, &propType, (PBYTE)&node, sizeof(node), nullptr, 0)
+       && propType == DEVPROP_TYPE_UINT32)
+    {
+      numaNode = node;
+    }
+  }
+  SetupDiDestroyDeviceInfoList(devInfos);
+  return numaNode;
+}
+
+// maps a CPU number to its processor group and the processor number within that group
+static std::optional<PROCESSOR_NUMBER> getProcessorNumber(uint32_t cpu)
+{
+  WORD numGroups = GetActiveProcessorGroupCount();
+  for(WORD group = 0; group < numGroups; ++group)
+  {
+    DWORD numGroupCpus = GetActiveProcessorCount(group);
+    if(cpu < numGroupCpus)
+    {
+      return PROCESSOR_NUMBER{group, (BYTE)cpu, 0};
+    }
+    cpu -= numGroupCpus;
+  }
+  return {};
+}
+
+std::vector<uint32_t> getAvailableCpus()
+{
+  // the process is either restricted to some processors of a single group, e.g. by "start /affinity", or may run on
+  // all processors of the groups it is assigned to
+  HANDLE process          = GetCurrentProcess();
+  USHORT numProcessGroups = 0;
+  GetProcessGroupAffinity(process, &numProcessGroups, nullptr);
+  std::vector<USHORT> processGroups(numProcessGroups);
+  if(numProcessGroups == 0 || !GetProcessGroupAffinity(process, &numProcessGroups, processGroups.data()))
+  {
+    return {};
+  }
+  DWORD_PTR processMask = 0;
+  DWORD_PTR systemMask  = 0;
+  // the mask is zero if the process spans several groups
+  if(!GetProcessAffinityMask(process, &processMask, &systemMask) || processMask == 0)
+  {
+    processMask = ~DWORD_PTR(0);
+  }
+  std::vector<uint32_t> cpus;
+  uint32_t              firstGroupCpu = 0;
+  WORD                  numGroups     = GetActiveProcessorGroupCount();
+  for(WORD group = 0; group < numGroups; ++group)
+  {
+    DWORD numGroupCpus = GetActiveProcessorCount(group);
+    if(std::find(processGroups.begin(), processGroups.end(), group) != processGroups.end())
+    {
+      for(DWORD i = 0; i < numGroupCpus; ++i)
+      {
+        if((processMask >> i) & 1)
+        {
+          cpus.emplace_back(firstGroupCpu + i);
+        }
+      }
+    }
+    firstGroupCpu += numGroupCpus;
+  }
+  return cpus;
+}
+
+std::optional<uint32_t> getNumaNodeOfCpu(uint32_t cpu)
+{
+  std::optional<PROCESSOR_NUMBER> procNumber = getProcessorNumber(cpu);
+  USHORT                          node       = 0;
+  if(!procNumber.has_value() || !GetNumaProcessorNodeEx(&procNumber.value(), &node) || node == 0xffff)
+  {
+    return {};
+  }
+  return node;
+}
+
+bool setThreadAffinity(std::thread& thread, uint32_t cpu)
+{
+  std::optional<PROCESSOR_NUMBER> procNumber = getProcessorNumber(cpu);
+  if(!procNumber.has_value())
+  {
+    return false;
+  }
+  GROUP_AFFINITY affinity{};
+  affinity.Group = procNumber.value().Group;
+  affinity.Mask  = KAFFINITY(1) << procNumber.value().Number;
+  return SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr) != 0;
+}
+#elif defined(__linux__)
+std::optional<uint32_t> getNumaNodeOfPciDevice(PciAddress const& address)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node", address.m_domain, address.m_bus,
+           address.m_device, address.m_function);
+  std::ifstream file(path);
+  int32_t       node = -1;
+  // the kernel reports -1 if the platform doesn't provide the device's NUMA node
+  if(!(file >> node) || node < 0)
+  {
+    return {};
+  }
+  return (uint32_t)node;
+}
+
+std::vector<uint32_t> getAvailableCpus()
+{
+  // the process may be restricted to a subset of the online CPUs, e.g. by taskset or a cgroup
+  std::vector<uint32_t> cpus;
+  cpu_set_t             cpuSet;
+  CPU_ZERO(&cpuSet);
+  if(sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0)
+  {
+    for(uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if(CPU_ISSET(cpu, &cpuSet))
+      {
+        cpus.emplace_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+std::optional<uint32_t> getNumaNodeOfCpu(uint32_t cpu)
+{
+  // node ids may be sparse, so all possible nodes are checked for a cpu list containing the cpu, e.g. "0-15,32-47"
+  for(uint32_t node = 0; node < 256; ++node)
+  {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string   range;
+    while(file && std::getline(file, range, ','))
+    {
+      uint32_t first = 0;
+      uint32_t last  = 0;
+      char     dash  = 0;
+      std::istringstream rangeStream(range);
+      if(!(rangeStream >> first))
+      {
+        continue;
+      }
+      last = (rangeStream >> dash >> last) ? last : first;
+      if(first <= cpu && cpu <= last)
+      {
+        return node;
+      }
+    }
+  }
+  return {};
+}
+
+bool setThreadAffinity(std::thread& thread, uint32_t cpu)
+{
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu, &cpuSet);
+  return pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet) == 0;
+}
+#else
+std::optional<uint32_t> getNumaNodeOfPciDevice(PciAddress const& address)
+{
+  return {};
+}
+
+std::vector<uint32_t> getAvailableCpus()
+{
+  return {};
+}
+
+std::optional<uint32_t> getNumaNodeOfCpu(uint32_t cpu)
+{
+  return {};
+}
+
+bool setThreadAffinity(std::thread& thread, uint32_t cpu)
+{
+  return false;
+}
+#endif
+}  // namespace vkdd
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "vkdd.hpp"
+
+#include <thread>
+
+namespace vkdd {
+// vk_ddisplay
+// on multi-socket systems each GPU is attached to the PCIe root complex of one socket, so the threads recording for a
+// GPU and the host memory they write should be on that socket's NUMA node
+// the queries are implemented for Windows and Linux, anywhere else they report no NUMA information and the placement
+// of threads is left to the OS
+struct PciAddress
+{
+  uint32_t m_domain;
+  uint32_t m_bus;
+  uint32_t m_device;
+  uint32_t m_function;
+};
+
+std::optional<uint32_t> getNumaNodeOfPciDevice(PciAddress const& address);
+// the logical CPUs the process may run on. on Windows the CPUs are numbered consecutively across all active processor
+// groups, which may be smaller than 64 processors, on Linux they are the ids of the kernel which may have gaps
+std::vector<uint32_t>   getAvailableCpus();
+std::optional<uint32_t> getNumaNodeOfCpu(uint32_t cpu);
+// pins the thread to a single logical CPU as numbered by getAvailableCpus()
+bool setThreadAffinity(std::thread& thread, uint32_t cpu);
+}  // namespace vkdd
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "free_interval_list.hpp"
+
+namespace vkdd {
+bool Interval::operator<(Interval const& right) const
+{
+  return m_begin != right.m_begin ? m_begin < right.m_begin : m_end < right.m_end;
+}
+
+bool Interval::intersects(Interval const& other) const
+{
+  return m_begin < other.m_end && other.m_begin < m_end;
+}
+
+FreeIntervalList::FreeIntervalList(size_t size)
+    : m_size(size)
+    , m_intervals{{0, size}}
+{
+}
+
+bool FreeIntervalList::isUnused() const
+{
+  return m_intervals.size() == 1 && m_intervals.front().m_begin == 0 && m_intervals.front().m_end == m_size;
+}
+
+std::optional<Interval> FreeIntervalList::requestInterval(size_t size, size_t alignment)
+{
+  for(auto it = m_intervals.begin(); it != m_intervals.end(); ++it)
+  {
+    Interval& interval     = *it;
+    size_t    alignedBegin = interval.m_begin + (alignment - interval.m_begin % alignment) % alignment;
+    if(alignedBegin + size <= interval.m_end)
+    {
+      if(alignedBegin == interval.m_begin && alignedBegin + size == interval.m_end)
+      {
+        m_intervals.erase(it);
+      }
+      else if(alignedBegin + size == interval.m_end)
+      {
+        interval.m_end = alignedBegin;
+      }
+      else
+      {
+        size_t prevIntervalBegin = interval.m_begin;
+        interval.m_begin         = alignedBegin + size;
+        if(prevIntervalBegin != alignedBegin)
+        {
+          m_intervals.insert(it, {prevIntervalBegin, alignedBegin});
+        }
+      }
+      return {{alignedBegin, alignedBegin + size}};
+    }
+  }
+  return {};
+}
+
+void FreeIntervalList::returnInterval(Interval interval)
+{
+  if(interval.m_begin == interval.m_end)
+  {
+    return;
+  }
+  auto lbIt = std::lower_bound(m_intervals.begin(), m_intervals.end(), interval);
+  if(lbIt == m_intervals.end())
+  {
+    if(!m_intervals.empty() && m_intervals.back().m_end == interval.m_begin)
+    {
+      m_intervals.back().m_end = interval.m_end;
+    }
+    else
+    {
+      m_intervals.emplace_back(interval);
+    }
+  }
+  else
+  {
+    assert(lbIt == m_intervals.begin() || !(lbIt - 1)->intersects(interval));
+    assert(!lbIt->intersects(interval));
+    bool mergeWithPrev = lbIt != m_intervals.begin() && (lbIt - 1)->m_end == interval.m_begin;
+    bool mergeWithNext = interval.m_end == lbIt->m_begin;
+    if(mergeWithPrev && mergeWithNext)
+    {
+      (lbIt - 1)->m_end = lbIt->m_end;
+      m_intervals.erase(lbIt);
+    }
+    else if(mergeWithPrev)
+    {
+      (lbIt - 1)->m_end = interval.m_end;
+    }
+    else if(mergeWithNext)
+    {
+      lbIt->m_begin = interval.m_begin;
+    }
+    else
+    {
+      m_intervals.insert(lbIt, interval);
+    }
+  }
+}
+}  // namespace vkdd
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "vkdd.hpp"
+
+namespace vkdd {
+struct Interval
+{
+  size_t m_begin;
+  size_t m_end;
+
+  bool operator<(Interval const& right) const;
+  bool intersects(Interval const& other) const;
+};
+
+// a sorted list of disjoint free intervals of a range [0, size)
+// intervals are requested first-fit and returned intervals are merged with their free neighbors
+class FreeIntervalList
+{
+public:
+  FreeIntervalList(size_t size);
+
+  std::optional<Interval>      requestInterval(size_t size, size_t alignment);
+  void                         returnInterval(Interval interval);
+  bool                         isUnused() const;
+  std::vector<Interval> const& getIntervals() const { return m_intervals; }
+
+private:
+  size_t                m_size;
+  std::vector<Interval> m_intervals;
+};
+}  // namespace vkdd
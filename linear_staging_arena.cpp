@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "linear_staging_arena.hpp"
+
+#include "logical_device.hpp"
+
+namespace vkdd {
+LinearStagingArena::LinearStagingArena(LogicalDevice& logicalDevice, vk::DeviceSize capacity)
+    : m_logicalDevice(logicalDevice)
+    , m_capacity(0)
+    , m_head(0)
+    , m_overflow(0)
+    , m_highWaterMark(0)
+{
+  this->allocateBuffer(capacity);
+}
+
+void LinearStagingArena::allocateBuffer(vk::DeviceSize capacity)
+{
+  m_bufferAllocation = {};
+  vk::BufferCreateInfo createInfo({}, capacity, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive);
+  m_bufferAllocation = m_logicalDevice.allocateStagingBuffer(createInfo);
+  m_capacity         = capacity;
+}
+
+std::optional<StagingBufferRange> LinearStagingArena::alloc(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+  vk::DeviceSize head = m_head.load(std::memory_order_relaxed);
+  vk::DeviceSize alignedBegin;
+  do
+  {
+    alignedBegin = head + (alignment - head % alignment) % alignment;
+    if(m_capacity < alignedBegin + size)
+    {
+      m_overflow.fetch_add(size + alignment, std::memory_order_relaxed);
+      return {};
+    }
+  } while(!m_head.compare_exchange_weak(head, alignedBegin + size, std::memory_order_relaxed));
+  return StagingBufferRange{m_bufferAllocation.m_buffer.get(), alignedBegin,
+                            (char*)m_bufferAllocation.m_allocation.mappedMem() + alignedBegin};
+}
+
+void LinearStagingArena::reset()
+{
+  // must only be called once the GPU has finished all transfers reading from this arena
+  vk::DeviceSize requiredCapacity = m_head.load() + m_overflow.load();
+  m_highWaterMark                 = std::max(m_highWaterMark, requiredCapacity);
+  if(m_capacity < requiredCapacity)
+  {
+    vk::DeviceSize capacity = std::max(requiredCapacity, 2 * m_capacity);
+    LOGI("Growing linear staging arena from %llu to %llu bytes.\n", (unsigned long long)m_capacity,
+         (unsigned long long)capacity);
+    this->allocateBuffer(capacity);
+  }
+  m_head     = 0;
+  m_overflow = 0;
+}
+}  // namespace vkdd
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "vkdd.hpp"
+
+#include "buffer_allocation.hpp"
+
+#include <atomic>
+
+namespace vkdd {
+struct StagingBufferRange
+{
+  vk::Buffer     m_buffer;
+  vk::DeviceSize m_offset;
+  void*          m_mapped;
+};
+
+// a linear staging arena is a single persistently mapped staging buffer from which host -> device transfers of a
+// single frame are served
+// ranges are handed out by atomically bumping an offset, so that multiple render threads can request staging memory
+// concurrently without any locking, and the whole arena is reset at once when the GPU is done with its frame
+// requests that do not fit anymore will fail and make the arena grow on its next reset
+// the high-water mark is the largest amount of staging memory ever requested within a single frame
+class LinearStagingArena
+{
+public:
+  LinearStagingArena(class LogicalDevice& logicalDevice, vk::DeviceSize capacity);
+
+  std::optional<StagingBufferRange> alloc(vk::DeviceSize size, vk::DeviceSize alignment);
+  void                              reset();
+  vk::DeviceSize                    getCapacity() const { return m_capacity; }
+  vk::DeviceSize                    getHighWaterMark() const { return m_highWaterMark; }
+
+private:
+  LogicalDevice&              m_logicalDevice;
+  BufferAllocation            m_bufferAllocation;
+  vk::DeviceSize              m_capacity;
+  std::atomic<vk::DeviceSize> m_head;
+  std::atomic<vk::DeviceSize> m_overflow;
+  vk::DeviceSize              m_highWaterMark;
+
+  void allocateBuffer(vk::DeviceSize capacity);
+};
+}  // namespace vkdd
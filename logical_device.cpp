@@ -20,6 +20,7 @@
 #include "logical_device.hpp"
 
 #include "command_execution_unit.hpp"
+#include "cpu_topology.hpp"
 #include "logical_display.hpp"
 #include "canvas_region_render_thread.hpp"
 #include "vulkan_memory_object_uploader.hpp"
@@ -29,6 +30,7 @@
 
 #include "_autogen/donut.vert.h"
 #include "_autogen/donut.frag.h"
+#include "_autogen/instance_expansion.comp.h"
 
 namespace vkdd {
 struct DeallocationContainer
@@ -37,6 +39,7 @@ struct DeallocationContainer
   VulkanMemoryPool::Allocation m_rawAllocation;
   BufferAllocation             m_bufferAllocation;
   ImageAllocation              m_imageAllocation;
+  BufferSuballocator::Range    m_bufferRange;
 
   bool operator<(DeallocationContainer const& other) const { return m_frameIndex < other.m_frameIndex; }
 };
@@ -44,7 +47,30 @@ struct DeallocationContainer
 LogicalDevice::LogicalDevice(vk::Instance instance, uint32_t devGroupIdx)
     : m_instance(instance)
     , m_devGroupIdx(devGroupIdx)
+    , m_frameTimelineValue(0)
+    , m_numRecordingSlots(1)
     , m_frameIndex(0)
+    , m_numQueuedFrames(DEFAULT_QUEUED_FRAMES)
+    , m_desiredNumQueuedFrames(DEFAULT_QUEUED_FRAMES)
+    , m_numEmptyFramesBeforePageRelease(600)
+    , m_numReservedEmptyPages(1)
+    , m_memoryBudgetSupported(false)
+    , m_useSecondaryCmdBuffers(false)
+    , m_cacheRenderCommands(false)
+    , m_useAsyncCompute(false)
+    , m_pipelinedRecording(false)
+    , m_frameInRecording(false)
+    , m_recordingSettings{}
+    , m_latencyStatistics{}
+    , m_frameMillis(0.0f)
+    , m_defragmentationEnabled(false)
+    , m_defragmentationActive(false)
+    , m_defragmentationMaxPageOccupancy(0.25f)
+    , m_defragmentationBytesPerFrame(1 << 20)
+    , m_defragmentationBudget(0)
+    , m_numRelocations(0)
+    , m_numFramesWithoutRelocation(0)
+    , m_defragmentationCmdExecUnit(nullptr)
 {
   std::vector<vk::PhysicalDeviceGroupProperties> devGroups = m_instance.enumeratePhysicalDeviceGroups();
   assert(m_devGroupIdx < devGroups.size());
@@ -53,12 +79,31 @@ LogicalDevice::LogicalDevice(vk::Instance instance, uint32_t devGroupIdx)
   {
     m_physicalDevices.emplace_back(devGroup.physicalDevices[i]);
   }
-  m_perSubDeviceMemPools = std::vector<MemPoolCollection>(m_physicalDevices.size());
+  // vk_ddisplay
+  // the physical devices of a device group may be attached to different sockets, so the render threads of each device
+  // are placed on the NUMA node of its PCIe bus, if it is known
+  for(vk::PhysicalDevice physicalDevice : m_physicalDevices)
+  {
+    std::optional<uint32_t>              numaNode;
+    std::vector<vk::ExtensionProperties> extProps = physicalDevice.enumerateDeviceExtensionProperties();
+    if(std::any_of(extProps.begin(), extProps.end(), [](vk::ExtensionProperties const& props) {
+         return std::string(props.extensionName.data()) == VK_EXT_PCI_BUS_INFO_EXTENSION_NAME;
+       }))
+    {
+      vk::PhysicalDevicePCIBusInfoPropertiesEXT pciBusInfo =
+          physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDevicePCIBusInfoPropertiesEXT>()
+              .get<vk::PhysicalDevicePCIBusInfoPropertiesEXT>();
+      numaNode = getNumaNodeOfPciDevice({pciBusInfo.pciDomain, pciBusInfo.pciBus, pciBusInfo.pciDevice, pciBusInfo.pciFunction});
+    }
+    LOGI("Device group %u, physical device %zu: NUMA node %d.\n", m_devGroupIdx, m_numaNodes.size(),
+         (int32_t)numaNode.value_or(-1));
+    m_numaNodes.push_back(numaNode);
+  }
 }
 
 LogicalDevice::~LogicalDevice() {}
 
-LogicalDisplay* LogicalDevice::enableDisplay(class Scene const& scene, vk::DisplayKHR display, CanvasRegion displayRegionOnCanvas)
+LogicalDisplay* LogicalDevice::enableDisplay(vk::DisplayKHR display, CanvasRegion displayRegionOnCanvas)
 {
   for(UniqueLogicalDisplay const& logicalDisplay : m_logicalDisplays)
   {
@@ -92,7 +137,7 @@ LogicalDisplay* LogicalDevice::enableDisplay(class Scene const& scene, vk::Displ
   // vk_ddisplay
   // create the logical display and provide the sub device indices
   UniqueLogicalDisplay logicalDisplay = std::make_unique<LogicalDisplay>(*this, display, displayRegionOnCanvas);
-  if(!logicalDisplay->init(scene, deviceIndices))
+  if(!logicalDisplay->init(deviceIndices))
   {
     LOGE("Initialization of logical display failed.\n");
     return nullptr;
@@ -144,8 +189,15 @@ void LogicalDevice::createDonutPipeline()
   vk::PipelineColorBlendStateCreateInfo colorBlendState({}, false, vk::LogicOp::eClear, attachment);
   std::vector<vk::DynamicState>         dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
   vk::PipelineDynamicStateCreateInfo    dynamicState({}, dynamicStates);
-  vk::PushConstantRange                 pushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(GlobalData));
-  vk::PipelineLayoutCreateInfo          pipelineLayoutCreateInfo({}, {}, pushConstantRange);
+  // the global data is read from a uniform buffer instead of push constants, so that recorded command buffers stay
+  // valid while it changes
+  std::vector<vk::DescriptorSetLayoutBinding> globalDataBindings = {
+      {0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex},
+      {1, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex},
+  };
+  m_donutDescriptorSetLayout = m_device->createDescriptorSetLayoutUnique({{}, globalDataBindings});
+  vk::DescriptorSetLayout      descriptorSetLayout = m_donutDescriptorSetLayout.get();
+  vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo({}, descriptorSetLayout);
   m_donutPipelineLayout = m_device->createPipelineLayoutUnique(pipelineLayoutCreateInfo);
   vk::GraphicsPipelineCreateInfo donutPipelineCreateInfo({}, stages, &vertexInputState, &inputAssemblyState, {},
                                                          &viewportState, &rasterizationState, &multisampleState,
@@ -156,6 +208,26 @@ void LogicalDevice::createDonutPipeline()
   m_donutPipeline = std::move(donutPipelineResult.value);
 }
 
+void LogicalDevice::createInstanceExpansionPipeline()
+{
+  m_instanceExpansionComp =
+      m_device->createShaderModuleUnique({{}, sizeof(instance_expansion_comp), instance_expansion_comp});
+  vk::PipelineShaderStageCreateInfo stage({}, vk::ShaderStageFlagBits::eCompute, m_instanceExpansionComp.get(), "main");
+  std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+      {0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+      {1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+  };
+  m_instanceExpansionDescriptorSetLayout = m_device->createDescriptorSetLayoutUnique({{}, bindings});
+  vk::DescriptorSetLayout      descriptorSetLayout = m_instanceExpansionDescriptorSetLayout.get();
+  vk::PushConstantRange        pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(InstanceExpansionParams));
+  vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo({}, descriptorSetLayout, pushConstantRange);
+  m_instanceExpansionPipelineLayout = m_device->createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+  vk::ComputePipelineCreateInfo pipelineCreateInfo({}, stage, m_instanceExpansionPipelineLayout.get());
+  auto pipelineResult = m_device->createComputePipelineUnique(m_donutPipelineCache.get(), pipelineCreateInfo);
+  assert(pipelineResult.result == vk::Result::eSuccess);
+  m_instanceExpansionPipeline = std::move(pipelineResult.value);
+}
+
 TriangleMesh* LogicalDevice::getDonutTriangleMesh(DeviceIndex deviceIndex, uint32_t baseNumTesselations)
 {
   std::lock_guard guard(m_donutTriMeshesMtx);
@@ -173,7 +245,7 @@ TriangleMesh* LogicalDevice::getDonutTriangleMesh(DeviceIndex deviceIndex, uint3
 
 MemTypeIndex LogicalDevice::getMemoryTypeIndex(DeviceIndex deviceIndex, uint32_t memoryTypeBits, vk::MemoryPropertyFlags memPropFlags)
 {
-  vk::PhysicalDeviceMemoryProperties memProps = m_physicalDevices[deviceIndex].getMemoryProperties();
+  vk::PhysicalDeviceMemoryProperties const& memProps = m_memProps[deviceIndex];
   for(uint32_t i = 0; i < memProps.memoryTypeCount; ++i)
   {
     if((memoryTypeBits & (1 << i)) && (memProps.memoryTypes[i].propertyFlags & memPropFlags) == memPropFlags)
@@ -210,23 +282,55 @@ VulkanMemoryPool::Allocation LogicalDevice::allocateDeviceMemory(OptionalDeviceI
                                                                  vk::MemoryPropertyFlags memPropFlags)
 {
   MemTypeIndex memTypeIdx = this->getMemoryTypeIndex(deviceIndex.value_or(0), memReqs.memoryTypeBits, memPropFlags);
+  if(memTypeIdx == (uint32_t)-1)
+  {
+    return {};
+  }
   return this->getMemPool(deviceIndex, memTypeIdx)->alloc(memReqs.size, memReqs.alignment);
 }
 
+VulkanMemoryPool::Allocation LogicalDevice::allocateDeviceMemory(OptionalDeviceIndex                    deviceIndex,
+                                                                 vk::MemoryRequirements                 memReqs,
+                                                                 vk::MemoryPropertyFlags                memPropFlags,
+                                                                 vk::MemoryDedicatedRequirements const& dedicatedReqs,
+                                                                 vk::MemoryDedicatedAllocateInfo const& dedicatedAllocateInfo)
+{
+  // vk_ddisplay
+  // large objects like the depth stencil and intermediate images get their own memory, so that they don't leave large
+  // unused tails in the pages and the driver can apply its dedicated allocation optimizations
+  if(!dedicatedReqs.requiresDedicatedAllocation && !dedicatedReqs.prefersDedicatedAllocation
+     && memReqs.size < MIN_DEDICATED_ALLOCATION_SIZE)
+  {
+    return this->allocateDeviceMemory(deviceIndex, memReqs, memPropFlags);
+  }
+  MemTypeIndex memTypeIdx = this->getMemoryTypeIndex(deviceIndex.value_or(0), memReqs.memoryTypeBits, memPropFlags);
+  if(memTypeIdx == (uint32_t)-1)
+  {
+    return {};
+  }
+  return this->getMemPool(deviceIndex, memTypeIdx)->allocDedicated(memReqs.size, dedicatedAllocateInfo);
+}
+
 BufferAllocation LogicalDevice::allocateBuffer(OptionalDeviceIndex deviceIndex, vk::BufferCreateInfo createInfo, vk::MemoryPropertyFlags memPropFlags)
 {
-  vk::UniqueBuffer        buffer  = m_device->createBufferUnique(createInfo);
-  vk::MemoryRequirements2 memReqs = m_device->getBufferMemoryRequirements(buffer.get());
-  VulkanMemoryPool::Allocation allocation = this->allocateDeviceMemory(deviceIndex, memReqs.memoryRequirements, memPropFlags);
+  vk::UniqueBuffer buffer = m_device->createBufferUnique(createInfo);
+  auto             memReqs = m_device->getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(
+      vk::BufferMemoryRequirementsInfo2(buffer.get()));
+  VulkanMemoryPool::Allocation allocation =
+      this->allocateDeviceMemory(deviceIndex, memReqs.get<vk::MemoryRequirements2>().memoryRequirements, memPropFlags,
+                                 memReqs.get<vk::MemoryDedicatedRequirements>(), vk::MemoryDedicatedAllocateInfo({}, buffer.get()));
   m_device->bindBufferMemory(buffer.get(), allocation.devMem(), allocation.devMemOffset());
-  return {std::move(buffer), std::move(allocation)};
+  return {std::move(buffer), std::move(allocation), createInfo.size, createInfo.usage};
 }
 
 ImageAllocation LogicalDevice::allocateImage(OptionalDeviceIndex deviceIndex, vk::ImageCreateInfo createInfo, vk::MemoryPropertyFlags memPropFlags)
 {
-  vk::UniqueImage         image   = m_device->createImageUnique(createInfo);
-  vk::MemoryRequirements2 memReqs = m_device->getImageMemoryRequirements(image.get());
-  VulkanMemoryPool::Allocation allocation = this->allocateDeviceMemory(deviceIndex, memReqs.memoryRequirements, memPropFlags);
+  vk::UniqueImage image   = m_device->createImageUnique(createInfo);
+  auto            memReqs = m_device->getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(
+      vk::ImageMemoryRequirementsInfo2(image.get()));
+  VulkanMemoryPool::Allocation allocation =
+      this->allocateDeviceMemory(deviceIndex, memReqs.get<vk::MemoryRequirements2>().memoryRequirements, memPropFlags,
+                                 memReqs.get<vk::MemoryDedicatedRequirements>(), vk::MemoryDedicatedAllocateInfo(image.get()));
   m_device->bindImageMemory(image.get(), allocation.devMem(), allocation.devMemOffset());
   return {std::move(image), std::move(allocation)};
 }
@@ -237,22 +341,51 @@ BufferAllocation LogicalDevice::allocateStagingBuffer(vk::BufferCreateInfo creat
   vk::MemoryRequirements       memReqs    = m_device->getBufferMemoryRequirements(buffer.get());
   VulkanMemoryPool::Allocation allocation = this->allocateStagingMemory(memReqs.size, memReqs.alignment);
   m_device->bindBufferMemory(buffer.get(), allocation.devMem(), allocation.devMemOffset());
-  return {std::move(buffer), std::move(allocation)};
+  return {std::move(buffer), std::move(allocation), createInfo.size, createInfo.usage};
+}
+
+BufferSuballocator::Range LogicalDevice::allocateInstanceBufferRange(DeviceIndex deviceIndex, vk::DeviceSize size)
+{
+  return m_instanceBufferSuballocators[deviceIndex]->alloc(size, 256);
+}
+
+StagingBufferRange LogicalDevice::allocateFrameStagingMemory(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+  // staging memory handed out by the current frame's arena stays valid until the GPU has finished this frame
+  std::optional<StagingBufferRange> range = m_stagingArenas[this->getCurrentFrameSlot()]->alloc(size, alignment);
+  if(range.has_value())
+  {
+    return range.value();
+  }
+  // the arena is too small for this frame and will grow on its next reset; until then the request is served by a
+  // dedicated staging buffer that is kept alive for as long as the frame may be in flight
+  BufferAllocation   allocation = this->allocateStagingBuffer(
+      {{}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive});
+  StagingBufferRange fallbackRange{allocation.m_buffer.get(), 0, allocation.m_allocation.mappedMem()};
+  this->scheduleForDeallocation(std::move(allocation));
+  return fallbackRange;
+}
+
+void LogicalDevice::scheduleForDeallocation(VulkanMemoryPool::Allocation allocation, std::optional<uint32_t> numFramesToKeepAlive)
+{
+  this->scheduleForDeallocation({m_frameIndex + numFramesToKeepAlive.value_or(m_numQueuedFrames), std::move(allocation)});
 }
 
-void LogicalDevice::scheduleForDeallocation(VulkanMemoryPool::Allocation allocation, uint32_t numFramesToKeepAlive)
+void LogicalDevice::scheduleForDeallocation(BufferAllocation allocation, std::optional<uint32_t> numFramesToKeepAlive)
 {
-  this->scheduleForDeallocation({m_frameIndex + numFramesToKeepAlive, std::move(allocation)});
+  this->scheduleForDeallocation({m_frameIndex + numFramesToKeepAlive.value_or(m_numQueuedFrames), {}, std::move(allocation)});
 }
 
-void LogicalDevice::scheduleForDeallocation(BufferAllocation allocation, uint32_t numFramesToKeepAlive)
+void LogicalDevice::scheduleForDeallocation(ImageAllocation allocation, std::optional<uint32_t> numFramesToKeepAlive)
 {
-  this->scheduleForDeallocation({m_frameIndex + numFramesToKeepAlive, {}, std::move(allocation)});
+  this->scheduleForDeallocation(
+      {m_frameIndex + numFramesToKeepAlive.value_or(m_numQueuedFrames), {}, {}, std::move(allocation)});
 }
 
-void LogicalDevice::scheduleForDeallocation(ImageAllocation allocation, uint32_t numFramesToKeepAlive)
+void LogicalDevice::scheduleForDeallocation(BufferSuballocator::Range range, std::optional<uint32_t> numFramesToKeepAlive)
 {
-  this->scheduleForDeallocation({m_frameIndex + numFramesToKeepAlive, {}, {}, std::move(allocation)});
+  this->scheduleForDeallocation(
+      {m_frameIndex + numFramesToKeepAlive.value_or(m_numQueuedFrames), {}, {}, {}, std::move(range)});
 }
 
 void LogicalDevice::scheduleForDeallocation(DeallocationContainer deallocation)
@@ -262,6 +395,109 @@ void LogicalDevice::scheduleForDeallocation(DeallocationContainer deallocation)
   m_deallocationQueue.insert(lbIt, std::move(deallocation));
 }
 
+bool LogicalDevice::relocateBuffer(BufferAllocation& bufferAllocation, DeviceIndex deviceIndex, bool preserveContents)
+{
+  // relocation is only possible while the device memory is being defragmented and only buffers located in an evacuated
+  // page are moved
+  if(!m_defragmentationCmdExecUnit || !bufferAllocation.m_allocation.isEvacuating())
+  {
+    return false;
+  }
+  // a buffer larger than the remaining budget may only be moved as the first one of a frame
+  if(preserveContents && m_defragmentationBudget < bufferAllocation.m_size
+     && m_defragmentationBudget != m_defragmentationBytesPerFrame)
+  {
+    return false;
+  }
+  vk::BufferCreateInfo createInfo({}, bufferAllocation.m_size, bufferAllocation.m_usage, vk::SharingMode::eExclusive);
+  BufferAllocation relocated = this->allocateBuffer(deviceIndex, createInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+  if(preserveContents)
+  {
+    // the buffers are owned by the graphics queue family, so copying them on the graphics queue avoids two queue family
+    // ownership transfers; the copies are submitted before any render thread's command buffer of this frame
+    vk::CommandBuffer& cmdBuffer = m_defragmentationCmdBuffers[deviceIndex];
+    if(!cmdBuffer)
+    {
+      cmdBuffer = m_defragmentationCmdExecUnit->requestCommandBuffer(m_graphicsQueueFamilyIndex,
+                                                                     DeviceMask::ofSingleDevice(deviceIndex));
+      cmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    }
+    cmdBuffer.copyBuffer(bufferAllocation.m_buffer.get(), relocated.m_buffer.get(),
+                         vk::BufferCopy(0, 0, bufferAllocation.m_size));
+    m_defragmentationBudget -= std::min(m_defragmentationBudget, bufferAllocation.m_size);
+  }
+  this->scheduleForDeallocation(std::move(bufferAllocation));
+  bufferAllocation = std::move(relocated);
+  ++m_numRelocations;
+  return true;
+}
+
+void LogicalDevice::defragmentDeviceMemory(CommandExecutionUnit& cmdExecUnit)
+{
+  // only the device local memory pools of the individual physical devices are compacted, because their pages contain
+  // the triangle mesh buffers which can be moved by their owners
+  bool evacuating = false;
+  for(MemPoolCollection const& memPools : m_perSubDeviceMemPools)
+  {
+    for(UniqueVulkanMemoryPool const& memPool : memPools)
+    {
+      evacuating |= memPool->beginEvacuation(m_defragmentationMaxPageOccupancy);
+    }
+  }
+  m_defragmentationActive = evacuating;
+  if(!evacuating)
+  {
+    m_numFramesWithoutRelocation = 0;
+    return;
+  }
+
+  m_defragmentationCmdExecUnit = &cmdExecUnit;
+  m_defragmentationBudget      = m_defragmentationBytesPerFrame;
+  m_numRelocations             = 0;
+  {
+    std::lock_guard guard(m_donutTriMeshesMtx);
+    for(auto& devIt : m_donutTriMeshes)
+    {
+      for(auto& triMeshIt : devIt.second)
+      {
+        triMeshIt.second->relocateBuffers();
+      }
+    }
+  }
+  vk::MemoryBarrier2 copyBarrier(vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+                                 vk::PipelineStageFlagBits2::eVertexAttributeInput | vk::PipelineStageFlagBits2::eIndexInput,
+                                 vk::AccessFlagBits2::eVertexAttributeRead | vk::AccessFlagBits2::eIndexRead);
+  for(auto const& it : m_defragmentationCmdBuffers)
+  {
+    it.second.pipelineBarrier2({{}, copyBarrier});
+    it.second.end();
+  }
+  m_defragmentationCmdBuffers.clear();
+  m_defragmentationCmdExecUnit = nullptr;
+
+  // the old allocations are kept alive until all frames in flight are done with them, so an evacuated page can only be
+  // released a couple of frames after its last allocation was moved
+  // if nothing could be moved for longer than that, the page contains allocations that cannot be moved at all
+  m_numFramesWithoutRelocation = m_numRelocations == 0 ? m_numFramesWithoutRelocation + 1 : 0;
+  if(m_numQueuedFrames < m_numFramesWithoutRelocation)
+  {
+    this->endDefragmentation();
+  }
+}
+
+void LogicalDevice::endDefragmentation()
+{
+  for(MemPoolCollection const& memPools : m_perSubDeviceMemPools)
+  {
+    for(UniqueVulkanMemoryPool const& memPool : memPools)
+    {
+      memPool->endEvacuation();
+    }
+  }
+  m_defragmentationActive      = false;
+  m_numFramesWithoutRelocation = 0;
+}
+
 std::optional<uint32_t> LogicalDevice::getQueueFamilyIndex(vk::QueueFlags flags, std::unordered_set<uint32_t> excludeQueueFamilyIndices)
 {
   std::unordered_set<uint32_t> candidates;
@@ -299,6 +535,45 @@ vk::Queue LogicalDevice::getQueue(uint32_t queueFamilyIndex) const
   return findIt == m_queues.end() ? nullptr : findIt->second;
 }
 
+std::vector<uint32_t> LogicalDevice::getQueueFamilyIndices() const
+{
+  std::vector<uint32_t> queueFamilyIndices = {m_graphicsQueueFamilyIndex, m_transferQueueFamilyIndex,
+                                              m_framebufferTransferQueueFamilyIndex};
+  if(m_computeQueueFamilyIndex.has_value()
+     && std::find(queueFamilyIndices.begin(), queueFamilyIndices.end(), m_computeQueueFamilyIndex.value())
+            == queueFamilyIndices.end())
+  {
+    queueFamilyIndices.emplace_back(m_computeQueueFamilyIndex.value());
+  }
+  return queueFamilyIndices;
+}
+
+RecordingSlotIndex LogicalDevice::registerRecordingThread()
+{
+  std::lock_guard guard(m_recordingSlotsMtx);
+  // the slots of unregistered threads are reused together with their command pools
+  if(!m_freeRecordingSlots.empty())
+  {
+    RecordingSlotIndex slotIndex = m_freeRecordingSlots.back();
+    m_freeRecordingSlots.pop_back();
+    return slotIndex;
+  }
+  // slot 0 belongs to the main thread
+  return m_numRecordingSlots++;
+}
+
+RecordingSlotIndex LogicalDevice::getNumRecordingSlots()
+{
+  std::lock_guard guard(m_recordingSlotsMtx);
+  return m_numRecordingSlots;
+}
+
+void LogicalDevice::unregisterRecordingThread(RecordingSlotIndex slotIndex)
+{
+  std::lock_guard guard(m_recordingSlotsMtx);
+  m_freeRecordingSlots.emplace_back(slotIndex);
+}
+
 bool LogicalDevice::start()
 {
   // starting a logical device will create all its resources, including its vkDevice, queues, memory pools, and render
@@ -327,33 +602,69 @@ bool LogicalDevice::start()
   m_graphicsQueueFamilyIndex            = graphicsQueueFamilyIndex.value();
   m_transferQueueFamilyIndex            = transferQueueFamilyIndex.value();
   m_framebufferTransferQueueFamilyIndex = framebufferTransferQueueFamilyIndex.value();
-  LOGI("Queue family indices - graphics: %d, transfer: %d, fb transfer: %d.\n", m_graphicsQueueFamilyIndex,
-       m_transferQueueFamilyIndex, m_framebufferTransferQueueFamilyIndex);
-
-  std::vector<float>                     queuePriorities     = {1.0f};
-  std::vector<vk::DeviceQueueCreateInfo> devQueueCreateInfos = {
-      {{}, m_graphicsQueueFamilyIndex, queuePriorities},
-      {{}, m_transferQueueFamilyIndex, queuePriorities},
-      {{}, m_framebufferTransferQueueFamilyIndex, queuePriorities},
-  };
+  // vk_ddisplay
+  // the async compute queue is optional. a compute family not used by the other queues is preferred, otherwise the
+  // compute work shares the queue of a transfer family which supports compute
+  m_computeQueueFamilyIndex = this->getQueueFamilyIndex(vk::QueueFlagBits::eCompute,
+                                                        {m_graphicsQueueFamilyIndex, m_transferQueueFamilyIndex,
+                                                         m_framebufferTransferQueueFamilyIndex});
+  if(!m_computeQueueFamilyIndex.has_value())
+  {
+    m_computeQueueFamilyIndex = this->getQueueFamilyIndex(vk::QueueFlagBits::eCompute, {m_graphicsQueueFamilyIndex});
+  }
+  LOGI("Queue family indices - graphics: %d, transfer: %d, fb transfer: %d, compute: %d.\n", m_graphicsQueueFamilyIndex,
+       m_transferQueueFamilyIndex, m_framebufferTransferQueueFamilyIndex, (int32_t)m_computeQueueFamilyIndex.value_or(-1));
+
+  std::vector<float>                     queuePriorities = {1.0f};
+  std::vector<vk::DeviceQueueCreateInfo> devQueueCreateInfos;
+  for(uint32_t queueFamilyIndex : this->getQueueFamilyIndices())
+  {
+    devQueueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags(), queueFamilyIndex, queuePriorities);
+  }
   std::vector<char const*>                    enabledExtensions = {"VK_KHR_swapchain", "VK_NV_acquire_winrt_display"};
+  for(vk::ExtensionProperties const& extProps : m_physicalDevices.front().enumerateDeviceExtensionProperties())
+  {
+    // the memory budget is optional and only used for the memory statistics
+    if(std::string(extProps.extensionName.data()) == "VK_EXT_memory_budget")
+    {
+      m_memoryBudgetSupported = true;
+      enabledExtensions.emplace_back("VK_EXT_memory_budget");
+    }
+  }
   vk::PhysicalDeviceSynchronization2Features  synchronization2Features(true);
   vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures(true, &synchronization2Features);
   vk::DeviceGroupDeviceCreateInfo             devGroupDevCreateInfo(m_physicalDevices, &timelineSemaphoreFeatures);
   vk::DeviceCreateInfo devCreateInfo({}, devQueueCreateInfos, {}, enabledExtensions, nullptr, &devGroupDevCreateInfo);
   m_device                                        = m_physicalDevices.front().createDeviceUnique(devCreateInfo);
-  m_queues[m_graphicsQueueFamilyIndex]            = m_device->getQueue(m_graphicsQueueFamilyIndex, 0);
-  m_queues[m_transferQueueFamilyIndex]            = m_device->getQueue(m_transferQueueFamilyIndex, 0);
-  m_queues[m_framebufferTransferQueueFamilyIndex] = m_device->getQueue(m_framebufferTransferQueueFamilyIndex, 0);
-  for(UniqueCommandExecutionUnit& cmdExecUnit : m_cmdExecUnits)
+  for(uint32_t queueFamilyIndex : this->getQueueFamilyIndices())
+  {
+    m_queues[queueFamilyIndex] = m_device->getQueue(queueFamilyIndex, 0);
+  }
+  this->createMemPools();
+  for(DeviceIndex deviceIndex = 0; deviceIndex < m_physicalDevices.size(); ++deviceIndex)
+  {
+    m_instanceBufferSuballocators.emplace_back(std::make_unique<BufferSuballocator>(
+        *this, deviceIndex,
+        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eUniformBuffer
+            | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal));
+  }
+  vk::SemaphoreTypeCreateInfo frameTimelineSemType(vk::SemaphoreType::eTimeline, 0);
+  for(DeviceIndex deviceIndex = 0; deviceIndex < m_physicalDevices.size(); ++deviceIndex)
   {
-    cmdExecUnit = std::make_unique<CommandExecutionUnit>(*this);
+    m_frameTimelineSemaphores.emplace_back(m_device->createSemaphoreUnique({{}, &frameTimelineSemType}));
   }
   m_uploader = std::make_unique<VulkanMemoryObjectUploader>(*this);
 
   MemTypeIndex stagingMemTypeIdx =
       this->getMemoryTypeIndex(0, ~0, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible);
   m_stagingMemPool = std::make_unique<VulkanMemoryPool>(m_device.get(), DeviceMask(), stagingMemTypeIdx, true);
+  m_numQueuedFrames = m_desiredNumQueuedFrames;
+  this->resizeFrameRings();
+  // the late-latched global data is written by the host while previous frames are in flight, so it's persistently
+  // mapped and has a slot for each possible queued frame
+  m_lateLatchedGlobalData = this->allocateStagingBuffer(
+      {{}, MAX_QUEUED_FRAMES * LATE_LATCHED_GLOBAL_DATA_STRIDE, vk::BufferUsageFlagBits::eUniformBuffer, vk::SharingMode::eExclusive});
 
   std::vector<vk::SurfaceFormatKHR> commonSurfaceFormats;
   if(!m_logicalDisplays.empty())
@@ -371,14 +682,19 @@ bool LogicalDevice::start()
                                               }),
                                commonSurfaceFormats.end());
   }
+  vk::Format        preferredFormat     = vk::Format::eB8G8R8A8Unorm;
+  vk::ColorSpaceKHR preferredColorSpace = vk::ColorSpaceKHR::eSrgbNonlinear;
+  // a device without displays starts headless with the preferred format, the benchmarks record and submit on it
+  if(m_logicalDisplays.empty())
+  {
+    commonSurfaceFormats.emplace_back(preferredFormat, preferredColorSpace);
+  }
   if(commonSurfaceFormats.empty())
   {
     LOGE("No common surface format for shared display.\n");
     return false;
   }
-  vk::Format           preferredFormat     = vk::Format::eB8G8R8A8Unorm;
-  vk::ColorSpaceKHR    preferredColorSpace = vk::ColorSpaceKHR::eSrgbNonlinear;
-  vk::SurfaceFormatKHR surfFormat          = commonSurfaceFormats.front();
+  vk::SurfaceFormatKHR surfFormat = commonSurfaceFormats.front();
   for(vk::SurfaceFormatKHR fmt : commonSurfaceFormats)
   {
     if(fmt.format == preferredFormat && fmt.colorSpace == preferredColorSpace)
@@ -403,6 +719,10 @@ bool LogicalDevice::start()
   m_donutRenderPass = m_device->createRenderPassUnique(renderPassCreateInfo);
 
   this->createDonutPipeline();
+  if(m_computeQueueFamilyIndex.has_value())
+  {
+    this->createInstanceExpansionPipeline();
+  }
 
   for(uint32_t i = 0; i < m_logicalDisplays.size(); ++i)
   {
@@ -414,33 +734,148 @@ bool LogicalDevice::start()
   return true;
 }
 
+void LogicalDevice::createMemPools()
+{
+  // a memory pool does not allocate any device memory before its first allocation, so pools for all memory types can be
+  // created up front
+  for(vk::PhysicalDevice physicalDevice : m_physicalDevices)
+  {
+    m_memProps.emplace_back(physicalDevice.getMemoryProperties());
+  }
+  for(MemTypeIndex memTypeIdx = 0; memTypeIdx < m_memProps.front().memoryTypeCount; ++memTypeIdx)
+  {
+    m_globalMemPools.emplace_back(std::make_unique<VulkanMemoryPool>(m_device.get(), DeviceMask(), memTypeIdx, false));
+  }
+  m_perSubDeviceMemPools.resize(m_physicalDevices.size());
+  for(DeviceIndex deviceIndex = 0; deviceIndex < m_physicalDevices.size(); ++deviceIndex)
+  {
+    for(MemTypeIndex memTypeIdx = 0; memTypeIdx < m_memProps[deviceIndex].memoryTypeCount; ++memTypeIdx)
+    {
+      m_perSubDeviceMemPools[deviceIndex].emplace_back(std::make_unique<VulkanMemoryPool>(
+          m_device.get(), DeviceMask::ofSingleDevice(deviceIndex), memTypeIdx, false));
+    }
+  }
+}
+
 VulkanMemoryPool* LogicalDevice::getMemPool(OptionalDeviceIndex deviceIndex, MemTypeIndex memTypeIdx)
 {
-  std::lock_guard guard(m_memPoolsMtx);
-  MemPoolCollection& memPoolCollection = deviceIndex.has_value() ? m_perSubDeviceMemPools[deviceIndex.value()] : m_globalMemPools;
-  if(auto findIt = memPoolCollection.find(memTypeIdx); findIt != memPoolCollection.end())
+  MemPoolCollection const& memPools = deviceIndex.has_value() ? m_perSubDeviceMemPools[deviceIndex.value()] : m_globalMemPools;
+  return memPools[memTypeIdx].get();
+}
+
+void LogicalDevice::setNumQueuedFrames(uint32_t numQueuedFrames)
+{
+  m_desiredNumQueuedFrames = std::clamp(numQueuedFrames, 1u, MAX_QUEUED_FRAMES);
+}
+
+void LogicalDevice::applyNumQueuedFrames()
+{
+  // vk_ddisplay
+  // all per-frame rings are indexed by the frame index modulo the number of queued frames, so changing it remaps the
+  // frames to other slots. the device is drained first, then none of the slots is in use anymore and the rings, as
+  // well as the swap chains, can be resized safely. the render threads are idle between two frames
+  for(UniqueCommandExecutionUnit const& cmdExecUnit : m_cmdExecUnits)
   {
-    return findIt->second.get();
+    if(cmdExecUnit)
+    {
+      cmdExecUnit->waitForIdle();
+    }
+  }
+  LOGI("Number of queued frames changed from %u to %u.\n", m_numQueuedFrames, m_desiredNumQueuedFrames);
+  m_numQueuedFrames = m_desiredNumQueuedFrames;
+  this->resizeFrameRings();
+  for(auto const& logicalDisplay : m_logicalDisplays)
+  {
+    logicalDisplay->resizeFrameRings();
+  }
+}
+
+void LogicalDevice::resizeFrameRings()
+{
+  // slots beyond the number of queued frames are released, so shrinking the queue also releases their memory
+  for(uint32_t slot = 0; slot < MAX_QUEUED_FRAMES; ++slot)
+  {
+    if(slot < m_numQueuedFrames)
+    {
+      if(!m_cmdExecUnits[slot])
+      {
+        m_cmdExecUnits[slot] = std::make_unique<CommandExecutionUnit>(*this);
+      }
+      if(!m_stagingArenas[slot])
+      {
+        m_stagingArenas[slot] = std::make_unique<LinearStagingArena>(*this, 4 << 20);
+      }
+    }
+    else
+    {
+      m_cmdExecUnits[slot].reset();
+      m_stagingArenas[slot].reset();
+    }
+  }
+}
+
+void LogicalDevice::render(SceneSnapshot const& scene)
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if(m_lastRenderTime != std::chrono::steady_clock::time_point())
+  {
+    float frameMillis = std::chrono::duration<float, std::milli>(now - m_lastRenderTime).count();
+    m_frameMillis     = m_frameMillis == 0.0f ? frameMillis : 0.95f * m_frameMillis + 0.05f * frameMillis;
+  }
+  m_lastRenderTime = now;
+
+  // vk_ddisplay
+  // in pipelined mode the frame submitted here has been recorded while the main thread was busy since the previous
+  // call, e.g. updating the scene, rendering the GUI, or rendering the other logical devices. the next frame is started
+  // right after the submission and is recorded from the same scene
+  if(!m_frameInRecording)
+  {
+    this->beginFrame(scene);
+  }
+  this->submitFrame();
+  if(m_pipelinedRecording)
+  {
+    this->beginFrame(scene);
   }
-  DeviceMask deviceMask = deviceIndex.has_value() ? DeviceMask::ofSingleDevice(deviceIndex.value()) : DeviceMask();
-  return memPoolCollection
-      .emplace(memTypeIdx, std::make_unique<VulkanMemoryPool>(m_device.get(), deviceMask, memTypeIdx, false))
-      .first->second.get();
 }
 
-void LogicalDevice::render()
+void LogicalDevice::beginFrame(SceneSnapshot const& scene)
 {
-  CommandExecutionUnit& cmdExecUnit = *m_cmdExecUnits[m_frameIndex % NUM_QUEUED_FRAMES];
-  cmdExecUnit.waitForIdleAndReset();
+  // the snapshot this frame is recorded from has been taken right before
+  m_recordingSampleTime = std::chrono::steady_clock::now();
+  if(m_desiredNumQueuedFrames != m_numQueuedFrames)
+  {
+    this->applyNumQueuedFrames();
+  }
+  CommandExecutionUnit& cmdExecUnit = *m_cmdExecUnits[this->getCurrentFrameSlot()];
+  cmdExecUnit.waitForIdleAndReset(this->getNumRecordingSlots());
+  this->updateLatencyStatistics(std::chrono::steady_clock::now());
+  m_stagingArenas[this->getCurrentFrameSlot()]->reset();
 
   m_uploader->prepare(cmdExecUnit);
+  if(m_defragmentationEnabled)
+  {
+    this->defragmentDeviceMemory(cmdExecUnit);
+  }
+  else if(m_defragmentationActive)
+  {
+    this->endDefragmentation();
+  }
+  m_recordingSettings = {m_useSecondaryCmdBuffers, m_cacheRenderCommands, m_useAsyncCompute, (bool)m_latchGlobalData};
   for(auto const& logicalDisplay : m_logicalDisplays)
   {
-    logicalDisplay->renderFrameAsync(cmdExecUnit);
+    logicalDisplay->renderFrameAsync(cmdExecUnit, scene, m_recordingSettings.m_useSecondaryCmdBuffers);
   }
-  std::vector<vk::Semaphore>    waitSems;
-  std::vector<vk::SwapchainKHR> swapchains;
-  std::vector<uint32_t>         imageIndices;
+  m_frameInRecording = true;
+}
+
+void LogicalDevice::submitFrame()
+{
+  CommandExecutionUnit&                 cmdExecUnit = *m_cmdExecUnits[this->getCurrentFrameSlot()];
+  std::chrono::steady_clock::time_point sampleTime  = m_recordingSampleTime;
+  std::vector<vk::Semaphore>            waitSems;
+  std::vector<vk::SwapchainKHR>         swapchains;
+  std::vector<uint32_t>                 imageIndices;
   for(auto const& logicalDisplay : m_logicalDisplays)
   {
     std::optional<LogicalDisplay::PresentData> presentData = logicalDisplay->finishFrameRendering(cmdExecUnit);
@@ -452,7 +887,21 @@ void LogicalDevice::render()
     }
   }
   m_uploader->finish();
+  // the frame may have been recorded without the late-latched slot, or the mode may have been disabled since
+  if(m_recordingSettings.m_lowLatency && m_latchGlobalData)
+  {
+    // vk_ddisplay
+    // the recorded command buffers only refer to this frame's slot, so the global data can be written right before
+    // the submission. host writes to coherent memory are visible to the GPU once the frame is submitted
+    GlobalData globalData = {};
+    m_latchGlobalData(globalData);
+    globalData.m_lateLatchSlot = NO_LATE_LATCH_SLOT;
+    uint8_t* mapped            = static_cast<uint8_t*>(m_lateLatchedGlobalData.m_allocation.mappedMem());
+    memcpy(mapped + this->getCurrentFrameSlot() * LATE_LATCHED_GLOBAL_DATA_STRIDE, &globalData, sizeof(GlobalData));
+    sampleTime = std::chrono::steady_clock::now();
+  }
   cmdExecUnit.submit();
+  m_pendingLatencySamples.push_back({cmdExecUnit.getCompletionValue(), sampleTime});
 
   // vk_ddisplay
   // all displays of this logical device can be presented at once
@@ -472,12 +921,135 @@ void LogicalDevice::render()
     ++it;
   }
   m_deallocationQueue.erase(m_deallocationQueue.begin(), it);
+  this->releaseEmptyMemoryPages();
+  this->collectMemoryStatistics();
   ++m_frameIndex;
+  m_frameInRecording = false;
+}
+
+void LogicalDevice::updateLatencyStatistics(std::chrono::steady_clock::time_point now)
+{
+  // the completion is only observed once per frame, so the latency is overestimated by up to one frame when the GPU
+  // is ahead, and it ends with the GPU work of the frame, not with the scanout
+  uint64_t frameTimelineValue = this->getCompletedFrameTimelineValue();
+  while(!m_pendingLatencySamples.empty() && m_pendingLatencySamples.front().m_completionValue <= frameTimelineValue)
+  {
+    float millis = std::chrono::duration<float, std::milli>(now - m_pendingLatencySamples.front().m_sampleTime).count();
+    m_latencyStatistics.m_millis =
+        m_latencyStatistics.m_millis == 0.0f ? millis : 0.95f * m_latencyStatistics.m_millis + 0.05f * millis;
+    m_pendingLatencySamples.pop_front();
+  }
+  m_latencyStatistics.m_frames = m_frameMillis == 0.0f ? 0.0f : m_latencyStatistics.m_millis / m_frameMillis;
+}
+
+uint64_t LogicalDevice::getCompletedFrameTimelineValue() const
+{
+  uint64_t frameTimelineValue = m_frameTimelineValue;
+  for(vk::UniqueSemaphore const& frameTimelineSem : m_frameTimelineSemaphores)
+  {
+    frameTimelineValue = std::min(frameTimelineValue, m_device->getSemaphoreCounterValue(frameTimelineSem.get()));
+  }
+  return frameTimelineValue;
+}
+
+uint32_t LogicalDevice::getNumFramesBehind() const
+{
+  if(m_frameTimelineSemaphores.empty())
+  {
+    return 0;
+  }
+  uint64_t frameTimelineValue = this->getCompletedFrameTimelineValue();
+  return (uint32_t)std::count_if(m_cmdExecUnits.begin(), m_cmdExecUnits.end(), [&](UniqueCommandExecutionUnit const& cmdExecUnit) {
+    return cmdExecUnit && !cmdExecUnit->isIdle(frameTimelineValue);
+  });
+}
+
+MemoryStatistics LogicalDevice::getMemoryStatistics()
+{
+  std::lock_guard guard(m_memoryStatisticsMtx);
+  return m_memoryStatistics;
+}
+
+void LogicalDevice::collectMemoryStatistics()
+{
+  MemoryStatistics memoryStatistics{m_frameIndex};
+  // pools of memory types which have never been used are left out
+  auto addPoolStatistics = [&](char const* poolName, OptionalDeviceIndex deviceIndex, VulkanMemoryPool& memPool) {
+    VulkanMemoryPool::Statistics stats = memPool.collectStatistics();
+    if(stats.m_numPages != 0 || stats.m_numAllocs != 0 || stats.m_numFrees != 0)
+    {
+      memoryStatistics.m_pools.push_back({poolName, deviceIndex, memPool.getMemTypeIndex(), stats});
+    }
+  };
+  addPoolStatistics("staging", {}, *m_stagingMemPool);
+  for(UniqueVulkanMemoryPool const& memPool : m_globalMemPools)
+  {
+    addPoolStatistics("global", {}, *memPool);
+  }
+  for(DeviceIndex deviceIndex = 0; deviceIndex < m_perSubDeviceMemPools.size(); ++deviceIndex)
+  {
+    for(UniqueVulkanMemoryPool const& memPool : m_perSubDeviceMemPools[deviceIndex])
+    {
+      addPoolStatistics("device", deviceIndex, *memPool);
+    }
+  }
+  if(m_memoryBudgetSupported)
+  {
+    for(DeviceIndex deviceIndex = 0; deviceIndex < m_physicalDevices.size(); ++deviceIndex)
+    {
+      auto memPropsChain =
+          m_physicalDevices[deviceIndex]
+              .getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+      vk::PhysicalDeviceMemoryProperties const& memProps =
+          memPropsChain.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+      vk::PhysicalDeviceMemoryBudgetPropertiesEXT const& budgetProps =
+          memPropsChain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+      for(uint32_t heapIndex = 0; heapIndex < memProps.memoryHeapCount; ++heapIndex)
+      {
+        memoryStatistics.m_heapBudgets.push_back({deviceIndex, heapIndex, memProps.memoryHeaps[heapIndex].size,
+                                                  budgetProps.heapBudget[heapIndex], budgetProps.heapUsage[heapIndex]});
+      }
+    }
+  }
+  std::lock_guard guard(m_memoryStatisticsMtx);
+  m_memoryStatistics = std::move(memoryStatistics);
+}
+
+void LogicalDevice::setPageReleasePolicy(uint32_t numEmptyFrames, uint32_t numReservedPages)
+{
+  m_numEmptyFramesBeforePageRelease = std::max(numEmptyFrames, 1u);
+  m_numReservedEmptyPages           = numReservedPages;
+}
+
+void LogicalDevice::releaseEmptyMemoryPages()
+{
+  // vk_ddisplay
+  // the application may run for a very long time, so the resident memory should follow the current scene instead of
+  // the peak usage
+  // pages are only released after having been empty for a while, scenes that are rebuilt regularly won't
+  // allocate and free the same memory every time
+  m_stagingMemPool->releaseEmptyPages(m_numEmptyFramesBeforePageRelease, m_numReservedEmptyPages);
+  for(UniqueVulkanMemoryPool const& memPool : m_globalMemPools)
+  {
+    memPool->releaseEmptyPages(m_numEmptyFramesBeforePageRelease, m_numReservedEmptyPages);
+  }
+  for(MemPoolCollection const& memPools : m_perSubDeviceMemPools)
+  {
+    for(UniqueVulkanMemoryPool const& memPool : memPools)
+    {
+      memPool->releaseEmptyPages(m_numEmptyFramesBeforePageRelease, m_numReservedEmptyPages);
+    }
+  }
 }
 
 void LogicalDevice::interrupt()
 {
-  m_cmdExecUnits[(m_frameIndex + NUM_QUEUED_FRAMES - 1) % NUM_QUEUED_FRAMES]->waitForIdle();
+  // a frame recorded ahead in pipelined mode is submitted, so that its acquired swap chain images are presented
+  if(m_frameInRecording)
+  {
+    this->submitFrame();
+  }
+  m_cmdExecUnits[(m_frameIndex + m_numQueuedFrames - 1) % m_numQueuedFrames]->waitForIdle();
   for(auto const& logicalDisplay : m_logicalDisplays)
   {
     logicalDisplay->interrupt();
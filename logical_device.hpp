@@ -21,29 +21,91 @@
 #include "vkdd.hpp"
 
 #include "buffer_allocation.hpp"
+#include "buffer_suballocator.hpp"
 #include "canvas_region.hpp"
+#include "command_execution_unit.hpp"
 #include "image_allocation.hpp"
+#include "linear_staging_arena.hpp"
 #include "triangle_mesh.hpp"
 #include "triangle_mesh_instance_set.hpp"
 #include "vulkan_memory_pool.hpp"
 
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <unordered_set>
 
 namespace vkdd {
+// matches the std140 layout of the donut shader's uniform buffer
+// m_lateLatchSlot selects the slot of the late-latched global data, or NO_LATE_LATCH_SLOT to use this data
 struct GlobalData
 {
-  Mat4x4f m_view;
-  Mat4x4f m_proj;
-  float   m_runtimeMillis;
+  Mat4x4f  m_view;
+  Mat4x4f  m_proj;
+  float    m_runtimeMillis;
+  uint32_t m_lateLatchSlot;
+};
+
+const uint32_t NO_LATE_LATCH_SLOT = ~0U;
+// the std140 array stride of GlobalData
+const vk::DeviceSize LATE_LATCHED_GLOBAL_DATA_STRIDE = 144;
+
+// fills in the global data of the low-latency mode right before a frame is submitted
+typedef std::function<void(GlobalData& globalData)> GlobalDataLatchFunc;
+
+// the latency is measured from sampling the scene state, which is the start of LogicalDevice::render() or the latching
+// of the global data in low-latency mode, until the GPU is observed to have finished the frame
+struct LatencyStatistics
+{
+  float m_millis;
+  float m_frames;
+};
+
+// matches the push constants of the instance expansion compute shader
+struct InstanceExpansionParams
+{
+  uint32_t m_numNodes;
+  uint32_t m_numFurLayers;
+  float    m_maxExtrusion;
+};
+
+struct MemoryPoolStatistics
+{
+  char const*                  m_poolName;
+  OptionalDeviceIndex          m_deviceIndex;
+  MemTypeIndex                 m_memTypeIdx;
+  VulkanMemoryPool::Statistics m_stats;
+};
+
+// heap budgets are only available if VK_EXT_memory_budget is supported
+struct MemoryHeapBudget
+{
+  DeviceIndex    m_deviceIndex;
+  uint32_t       m_heapIndex;
+  vk::DeviceSize m_heapSize;
+  vk::DeviceSize m_budget;
+  vk::DeviceSize m_usage;
+};
+
+struct MemoryStatistics
+{
+  FrameIndex                        m_frameIndex;
+  std::vector<MemoryPoolStatistics> m_pools;
+  std::vector<MemoryHeapBudget>     m_heapBudgets;
 };
 
 // vk_ddisplay
 // a logical device represents a Vulkan device group and manages different things
 // * a set of enabled logical displays attached to the device group's physical devices
 // * a graphics queue for rendering and a dedicated transfer queue for host -> device / device -> device transfers
-// * a set of buffered command execution units which provide an easy way to record multiple command buffers in parallel
+// * an optional async compute queue, which generates the triangle mesh instances on the device
+// * a set of buffered command execution units which provide an easy way to record multiple command buffers in parallel,
+//   one for each queued frame. the number of queued frames may change at runtime
 // * a set of memory pools, one for each physical device
 // * a single staging memory pool (host-visible and host coherent)
+// * a ring of linear staging arenas, one for each queued frame, for per-frame host -> device transfers
+// * an optional incremental defragmentation of the physical devices' memory pools
+// * an optional pipelined mode, in which the next frame is recorded while the main thread is busy elsewhere
 // * the main render pass and device local triangle mesh geomtry resources
 class LogicalDevice
 {
@@ -53,18 +115,42 @@ public:
   LogicalDevice(vk::Instance instance, uint32_t devGroupIdx);
   ~LogicalDevice();
 
-  [[nodiscard]] LogicalDisplay* enableDisplay(class Scene const& scene, vk::DisplayKHR display, CanvasRegion displayRegionOnCanvas);
+  [[nodiscard]] LogicalDisplay* enableDisplay(vk::DisplayKHR display, CanvasRegion displayRegionOnCanvas);
   vk::Instance       vkInstance() const { return m_instance; }
   vk::Device         vkDevice() const { return m_device.get(); }
   FrameIndex         getCurrentFrameIndex() const { return m_frameIndex; }
+  // index of the current frame's slot in all per-frame rings
+  uint32_t           getCurrentFrameSlot() const { return (uint32_t)(m_frameIndex % m_numQueuedFrames); }
+  uint32_t           getNumQueuedFrames() const { return m_numQueuedFrames; }
+  // clamped to [1, MAX_QUEUED_FRAMES], the change is applied at the beginning of the next rendered frame
+  void               setNumQueuedFrames(uint32_t numQueuedFrames);
   vk::PhysicalDevice getPhysicalDevice(DeviceIndex deviceIndex) const { return m_physicalDevices[deviceIndex]; }
+  // the NUMA node of the physical device's PCIe root complex, requires VK_EXT_pci_bus_info
+  std::optional<uint32_t> getNumaNode(DeviceIndex deviceIndex) const { return m_numaNodes[deviceIndex]; }
   uint32_t           getNumPhysicalDevices() const { return (uint32_t)m_physicalDevices.size(); }
   uint32_t           getGraphicsQueueFamilyIndex() const { return m_graphicsQueueFamilyIndex; }
   uint32_t           getTransferQueueFamilyIndex() const { return m_transferQueueFamilyIndex; }
+  // not available if no queue family apart from the graphics queue family supports compute
+  std::optional<uint32_t> getComputeQueueFamilyIndex() const { return m_computeQueueFamilyIndex; }
   vk::Queue          getQueue(uint32_t queueFamilyIndex) const;
+  std::vector<uint32_t> getQueueFamilyIndices() const;
+  RecordingSlotIndex    registerRecordingThread();
+  // slots of all threads ever registered, including the main thread's
+  RecordingSlotIndex    getNumRecordingSlots();
+  // must only be called once the thread stopped recording
+  void                  unregisterRecordingThread(RecordingSlotIndex slotIndex);
+  // every physical device signals its own frame timeline, so that a frame is only complete once all of them are done
+  vk::Semaphore getFrameTimelineSemaphore(DeviceIndex deviceIndex) const { return m_frameTimelineSemaphores[deviceIndex].get(); }
+  // the last frame timeline value which has been reached on all physical devices, doesn't block
+  uint64_t              getCompletedFrameTimelineValue() const;
+  uint64_t              advanceFrameTimelineValue() { return ++m_frameTimelineValue; }
+  // number of submitted frames the GPU didn't finish yet, doesn't block
+  uint32_t getNumFramesBehind() const;
   class VulkanMemoryObjectUploader& getUploader() const { return *m_uploader; }
   [[nodiscard]] bool                start();
-  void                              render();
+  // the snapshot must not change until the frame recorded from it has been submitted, which in pipelined mode happens
+  // during the next call
+  void                              render(struct SceneSnapshot const& scene);
   void                              interrupt();
   void                              join();
 
@@ -76,58 +162,184 @@ public:
                                                     vk::MemoryRequirements  memReqs,
                                                     vk::MemoryPropertyFlags memPropFlags);
 
-  BufferAllocation allocateStagingBuffer(vk::BufferCreateInfo createInfo);
+  BufferAllocation   allocateStagingBuffer(vk::BufferCreateInfo createInfo);
+  StagingBufferRange allocateFrameStagingMemory(vk::DeviceSize size, vk::DeviceSize alignment = 16);
   BufferAllocation allocateBuffer(OptionalDeviceIndex deviceIndex, vk::BufferCreateInfo createInfo, vk::MemoryPropertyFlags memPropFlags);
   ImageAllocation allocateImage(OptionalDeviceIndex deviceIndex, vk::ImageCreateInfo createInfo, vk::MemoryPropertyFlags memPropFlags);
+  // instance buffer ranges can be bound as vertex buffers, uniform buffers, and storage buffers
+  BufferSuballocator::Range allocateInstanceBufferRange(DeviceIndex deviceIndex, vk::DeviceSize size);
+
+  // objects are kept alive for the number of queued frames by default
+  void scheduleForDeallocation(VulkanMemoryPool::Allocation allocation, std::optional<uint32_t> remainingFramesToKeepAlive = {});
+  void scheduleForDeallocation(BufferAllocation allocation, std::optional<uint32_t> remainingFramesToKeepAlive = {});
+  void scheduleForDeallocation(ImageAllocation allocation, std::optional<uint32_t> remainingFramesToKeepAlive = {});
+  void scheduleForDeallocation(BufferSuballocator::Range range, std::optional<uint32_t> remainingFramesToKeepAlive = {});
+
+  void setDefragmentationEnabled(bool enabled) { m_defragmentationEnabled = enabled; }
+  // render threads record secondary command buffers which are executed in one render pass per display and device
+  void setSecondaryCommandBuffersEnabled(bool enabled) { m_useSecondaryCmdBuffers = enabled; }
+  // render threads reuse their recorded render commands as long as they stay the same
+  void setRenderCommandCachingEnabled(bool enabled) { m_cacheRenderCommands = enabled; }
+  bool isRenderCommandCachingEnabled() const { return m_recordingSettings.m_cacheRenderCommands; }
+  // render threads generate their instances on the async compute queue instead of uploading them
+  void setAsyncComputeEnabled(bool enabled) { m_useAsyncCompute = enabled; }
+  bool isAsyncComputeEnabled() const { return m_recordingSettings.m_useAsyncCompute && m_computeQueueFamilyIndex.has_value(); }
+  // in low-latency mode the camera and the runtime are latched right before submission instead of being recorded,
+  // an empty function disables it
+  void setLowLatencyMode(GlobalDataLatchFunc latchFunc) { m_latchGlobalData = std::move(latchFunc); }
+  bool isLowLatencyEnabled() const { return m_recordingSettings.m_lowLatency; }
+  // in pipelined mode render() submits the frame recorded since the previous call and immediately starts recording the
+  // next one, instead of recording and submitting the same frame
+  void setPipelinedRecordingEnabled(bool enabled) { m_pipelinedRecording = enabled; }
+  // a uniform buffer with one GlobalData slot per queued frame, indexed by the frame slot
+  vk::Buffer        getLateLatchedGlobalDataBuffer() const { return m_lateLatchedGlobalData.m_buffer.get(); }
+  LatencyStatistics getLatencyStatistics() const { return m_latencyStatistics; }
+  void setPageReleasePolicy(uint32_t numEmptyFrames, uint32_t numReservedPages);
+  // statistics of the last rendered frame
+  MemoryStatistics getMemoryStatistics();
+  bool relocateBuffer(BufferAllocation& bufferAllocation, DeviceIndex deviceIndex, bool preserveContents);
 
-  void scheduleForDeallocation(VulkanMemoryPool::Allocation allocation, uint32_t remainingFramesToKeepAlive = NUM_QUEUED_FRAMES);
-  void scheduleForDeallocation(BufferAllocation allocation, uint32_t remainingFramesToKeepAlive = NUM_QUEUED_FRAMES);
-  void scheduleForDeallocation(ImageAllocation allocation, uint32_t remainingFramesToKeepAlive = NUM_QUEUED_FRAMES);
+  vk::RenderPass          getDonutRenderPass() const { return m_donutRenderPass.get(); }
+  vk::DescriptorSetLayout getDonutDescriptorSetLayout() const { return m_donutDescriptorSetLayout.get(); }
+  vk::PipelineLayout      getDonutPipelineLayout() const { return m_donutPipelineLayout.get(); }
+  vk::Pipeline            getDonutPipeline() const { return m_donutPipeline.get(); }
+  TriangleMesh*           getDonutTriangleMesh(DeviceIndex deviceIndex, uint32_t baseNumTesselations);
 
-  vk::RenderPass     getDonutRenderPass() const { return m_donutRenderPass.get(); }
-  vk::PipelineLayout getDonutPipelineLayout() const { return m_donutPipelineLayout.get(); }
-  vk::Pipeline       getDonutPipeline() const { return m_donutPipeline.get(); }
-  TriangleMesh*      getDonutTriangleMesh(DeviceIndex deviceIndex, uint32_t baseNumTesselations);
+  vk::DescriptorSetLayout getInstanceExpansionDescriptorSetLayout() const
+  {
+    return m_instanceExpansionDescriptorSetLayout.get();
+  }
+  vk::PipelineLayout getInstanceExpansionPipelineLayout() const { return m_instanceExpansionPipelineLayout.get(); }
+  vk::Pipeline       getInstanceExpansionPipeline() const { return m_instanceExpansionPipeline.get(); }
 
 private:
   typedef std::unique_ptr<class CommandExecutionUnit>              UniqueCommandExecutionUnit;
   typedef std::unique_ptr<VulkanMemoryPool>                        UniqueVulkanMemoryPool;
-  typedef std::unordered_map<MemTypeIndex, UniqueVulkanMemoryPool> MemPoolCollection;
+  typedef std::unique_ptr<LinearStagingArena>                      UniqueLinearStagingArena;
+  // one pool per memory type, indexed by the memory type index
+  typedef std::vector<UniqueVulkanMemoryPool>                      MemPoolCollection;
   typedef std::unique_ptr<class CommandExecutionUnit>              UniqueCommandExecutionUnit;
 
+  // the settings are latched when a frame's recording starts, so that the main thread may change them while the render
+  // threads are recording in pipelined mode
+  struct RecordingSettings
+  {
+    bool m_useSecondaryCmdBuffers;
+    bool m_cacheRenderCommands;
+    bool m_useAsyncCompute;
+    bool m_lowLatency;
+  };
+
+  // device memory allocations of at least this size don't go through the memory pools' pages
+  static constexpr vk::DeviceSize MIN_DEDICATED_ALLOCATION_SIZE = 2 << 20;
+
   vk::Instance                                              m_instance;
   uint32_t                                                  m_devGroupIdx;
   std::vector<vk::PhysicalDevice>                           m_physicalDevices;
+  std::vector<std::optional<uint32_t>>                      m_numaNodes;
   vk::UniqueDevice                                          m_device;
   uint32_t                                                  m_graphicsQueueFamilyIndex;
   uint32_t                                                  m_transferQueueFamilyIndex;
   uint32_t                                                  m_framebufferTransferQueueFamilyIndex;
+  std::optional<uint32_t>                                   m_computeQueueFamilyIndex;
   std::unordered_map<uint32_t, vk::Queue>                   m_queues;
   vk::UniqueSemaphore                                       m_transferQueueSyncSemaphore;
-  std::array<UniqueCommandExecutionUnit, NUM_QUEUED_FRAMES> m_cmdExecUnits;
+  std::vector<vk::UniqueSemaphore>                          m_frameTimelineSemaphores;
+  uint64_t                                                  m_frameTimelineValue;
+  std::array<UniqueCommandExecutionUnit, MAX_QUEUED_FRAMES> m_cmdExecUnits;
+  RecordingSlotIndex                                        m_numRecordingSlots;
+  std::vector<RecordingSlotIndex>                           m_freeRecordingSlots;
+  std::mutex                                                m_recordingSlotsMtx;
   UniqueVulkanMemoryPool                                    m_stagingMemPool;
+  std::array<UniqueLinearStagingArena, MAX_QUEUED_FRAMES>   m_stagingArenas;
+  // the memory properties and all memory pools are created in start() and never change afterwards, so allocations can
+  // look them up without locking
+  std::vector<vk::PhysicalDeviceMemoryProperties>           m_memProps;
   MemPoolCollection                                         m_globalMemPools;
   std::vector<MemPoolCollection>                            m_perSubDeviceMemPools;
-  std::mutex                                                m_memPoolsMtx;
+  std::vector<std::unique_ptr<BufferSuballocator>>          m_instanceBufferSuballocators;
   std::vector<struct DeallocationContainer>                 m_deallocationQueue;
   std::mutex                                                m_deallocationQueueMtx;
   std::unique_ptr<VulkanMemoryObjectUploader>               m_uploader;
   std::vector<UniqueLogicalDisplay>                         m_logicalDisplays;
   FrameIndex                                                m_frameIndex;
+  uint32_t                                                  m_numQueuedFrames;
+  uint32_t                                                  m_desiredNumQueuedFrames;
+  uint32_t                                                  m_numEmptyFramesBeforePageRelease;
+  uint32_t                                                  m_numReservedEmptyPages;
+  bool                                                      m_memoryBudgetSupported;
+  bool                                                      m_useSecondaryCmdBuffers;
+  bool                                                      m_cacheRenderCommands;
+  bool                                                      m_useAsyncCompute;
+  bool                                                      m_pipelinedRecording;
+  // the current frame's recording has been started but the frame has not been submitted yet
+  bool                                                      m_frameInRecording;
+  RecordingSettings                                         m_recordingSettings;
+  std::chrono::steady_clock::time_point                     m_recordingSampleTime;
+  MemoryStatistics                                          m_memoryStatistics;
+  std::mutex                                                m_memoryStatisticsMtx;
+
+  // low-latency mode and latency measurement
+  struct LatencySample
+  {
+    uint64_t                              m_completionValue;
+    std::chrono::steady_clock::time_point m_sampleTime;
+  };
+
+  BufferAllocation                      m_lateLatchedGlobalData;
+  GlobalDataLatchFunc                   m_latchGlobalData;
+  std::deque<LatencySample>             m_pendingLatencySamples;
+  LatencyStatistics                     m_latencyStatistics;
+  float                                 m_frameMillis;
+  std::chrono::steady_clock::time_point m_lastRenderTime;
+
+  // device memory defragmentation
+  bool                                               m_defragmentationEnabled;
+  bool                                               m_defragmentationActive;
+  float                                              m_defragmentationMaxPageOccupancy;
+  vk::DeviceSize                                     m_defragmentationBytesPerFrame;
+  vk::DeviceSize                                     m_defragmentationBudget;
+  uint32_t                                           m_numRelocations;
+  uint32_t                                           m_numFramesWithoutRelocation;
+  CommandExecutionUnit*                              m_defragmentationCmdExecUnit;
+  std::unordered_map<DeviceIndex, vk::CommandBuffer> m_defragmentationCmdBuffers;
 
   // donut rendering
   vk::UniquePipelineCache                                                                      m_donutPipelineCache;
   vk::UniqueShaderModule                                                                       m_donutVert;
   vk::UniqueShaderModule                                                                       m_donutFrag;
+  vk::UniqueDescriptorSetLayout                                                                m_donutDescriptorSetLayout;
   vk::UniquePipelineLayout                                                                     m_donutPipelineLayout;
   vk::UniquePipeline                                                                           m_donutPipeline;
   vk::UniqueRenderPass                                                                         m_donutRenderPass;
   std::unordered_map<DeviceIndex, std::unordered_map<uint32_t, std::unique_ptr<TriangleMesh>>> m_donutTriMeshes;
   std::mutex                                                                                   m_donutTriMeshesMtx;
 
+  // instance expansion, only created if there is an async compute queue
+  vk::UniqueShaderModule        m_instanceExpansionComp;
+  vk::UniqueDescriptorSetLayout m_instanceExpansionDescriptorSetLayout;
+  vk::UniquePipelineLayout      m_instanceExpansionPipelineLayout;
+  vk::UniquePipeline            m_instanceExpansionPipeline;
+
   MemTypeIndex getMemoryTypeIndex(DeviceIndex deviceIndex, uint32_t memoryTypeBits, vk::MemoryPropertyFlags memPropFlags);
   VulkanMemoryPool* getMemPool(OptionalDeviceIndex deviceIndex, MemTypeIndex memTypeIdx);
+  VulkanMemoryPool::Allocation allocateDeviceMemory(OptionalDeviceIndex                    deviceIndex,
+                                                    vk::MemoryRequirements                 memReqs,
+                                                    vk::MemoryPropertyFlags                memPropFlags,
+                                                    vk::MemoryDedicatedRequirements const& dedicatedReqs,
+                                                    vk::MemoryDedicatedAllocateInfo const& dedicatedAllocateInfo);
+  void              createMemPools();
   void              createDonutPipeline();
+  void              createInstanceExpansionPipeline();
+  void              applyNumQueuedFrames();
+  void              beginFrame(struct SceneSnapshot const& scene);
+  void              submitFrame();
+  void              resizeFrameRings();
+  void              updateLatencyStatistics(std::chrono::steady_clock::time_point now);
+  void              defragmentDeviceMemory(CommandExecutionUnit& cmdExecUnit);
+  void              endDefragmentation();
+  void              releaseEmptyMemoryPages();
+  void              collectMemoryStatistics();
   void              scheduleForDeallocation(DeallocationContainer allocation);
   std::optional<uint32_t> getQueueFamilyIndex(vk::QueueFlags flags, std::unordered_set<uint32_t> excludeQueueFamilyIndices);
 };
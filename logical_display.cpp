@@ -34,12 +34,13 @@ LogicalDisplay::LogicalDisplay(LogicalDevice& logicalDevice, vk::DisplayKHR disp
     : m_display(display)
     , m_displayRegionOnCanvas(displayRegionOnCanvas)
     , m_logicalDevice(logicalDevice)
+    , m_useSecondaryCmdBuffers(false)
 {
 }
 
 LogicalDisplay::~LogicalDisplay() {}
 
-bool LogicalDisplay::init(class Scene const& scene, std::vector<DeviceIndex> const& deviceIndices)
+bool LogicalDisplay::init(std::vector<DeviceIndex> const& deviceIndices)
 {
   if(deviceIndices.empty())
   {
@@ -92,12 +93,12 @@ bool LogicalDisplay::init(class Scene const& scene, std::vector<DeviceIndex> con
   // there is one dedicated render context for each device rendering to the desired display
   for(DeviceIndex devIdx : deviceIndices)
   {
-    this->pushRenderContext(scene, devIdx);
+    this->pushRenderContext(devIdx);
   }
   return true;
 }
 
-void LogicalDisplay::pushRenderContext(class Scene const& scene, DeviceIndex deviceIndex)
+void LogicalDisplay::pushRenderContext(DeviceIndex deviceIndex)
 {
   // vk_ddisplay
   // each physical device provides one ore more present rectangles for the display's surface
@@ -163,7 +164,7 @@ void LogicalDisplay::pushRenderContext(class Scene const& scene, DeviceIndex dev
   vk::Viewport viewport(vpOffsetX, vpOffsetY, vpWidth, vpHeight, 0.0f, 1.0f);
   vk::Rect2D   renderArea = vk::Rect2D{{minX, minY}, {(uint32_t)(maxX - minX), (uint32_t)(maxY - minY)}};
   m_canvasRegionsRenderThreads.emplace_back(
-      std::make_unique<CanvasRegionRenderThread>(scene, m_logicalDevice, deviceIndex, renderArea, viewport));
+      std::make_unique<CanvasRegionRenderThread>(m_logicalDevice, deviceIndex, renderArea, viewport));
   m_deviceMask.add(deviceIndex);
 }
 
@@ -218,15 +219,11 @@ bool LogicalDisplay::start(vk::SurfaceFormatKHR swapchainSurfFormat, vk::RenderP
     }
   }
 
-  vk::SurfaceCapabilitiesKHR surfCaps = mainPhysicalDevice.getSurfaceCapabilitiesKHR(m_surface.get());
-  uint32_t imageCount = std::max(surfCaps.minImageCount, std::min(NUM_QUEUED_FRAMES, surfCaps.maxImageCount));
+  m_swapchainSurfFormat = swapchainSurfFormat;
+  m_presentMode         = presentMode;
+  m_renderPass          = renderPass;
 
-  vk::DeviceGroupSwapchainCreateInfoKHR deviceGroupSwapchainCreateInfo(vk::DeviceGroupPresentModeFlagBitsKHR::eLocalMultiDevice);
-  vk::SwapchainCreateInfoKHR swapchainCreateInfo(
-      {}, m_surface.get(), imageCount, swapchainSurfFormat.format, swapchainSurfFormat.colorSpace, surfCaps.currentExtent,
-      1, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {},
-      surfCaps.currentTransform, vk::CompositeAlphaFlagBitsKHR::eOpaque, presentMode, true, {}, &deviceGroupSwapchainCreateInfo);
-  m_swapchain = m_logicalDevice.vkDevice().createSwapchainKHRUnique(swapchainCreateInfo);
+  vk::SurfaceCapabilitiesKHR surfCaps = mainPhysicalDevice.getSurfaceCapabilitiesKHR(m_surface.get());
   for(vk::UniqueSemaphore& sem : m_imageAcquiredSemaphores)
   {
     sem = m_logicalDevice.vkDevice().createSemaphoreUnique({});
@@ -243,19 +240,7 @@ bool LogicalDisplay::start(vk::SurfaceFormatKHR swapchainSurfFormat, vk::RenderP
       {}, m_depthStencil.m_image.get(), vk::ImageViewType::e2D, depthStencilImageCreateInfo.format, {},
       {vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil, 0, 1, 0, 1});
   m_depthStencilImageView = m_logicalDevice.vkDevice().createImageViewUnique(depthStencilImageViewCreateInfo);
-
-  for(vk::Image swapchainImage : m_logicalDevice.vkDevice().getSwapchainImagesKHR(m_swapchain.get()))
-  {
-    vk::ImageViewCreateInfo swapchainImageViewCreateInfo({}, swapchainImage, vk::ImageViewType::e2D, swapchainSurfFormat.format,
-                                                         {vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity,
-                                                          vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity},
-                                                         vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
-    m_swapchainImageViews.emplace_back(m_logicalDevice.vkDevice().createImageViewUnique(swapchainImageViewCreateInfo));
-    std::vector<vk::ImageView> framebufferAttachments = {m_swapchainImageViews.back().get(), m_depthStencilImageView.get()};
-    vk::FramebufferCreateInfo frameBufferCreateInfo({}, renderPass, framebufferAttachments,
-                                                    surfCaps.currentExtent.width, surfCaps.currentExtent.height, 1);
-    m_framebuffers.emplace_back(m_logicalDevice.vkDevice().createFramebufferUnique(frameBufferCreateInfo));
-  }
+  this->createSwapchain();
 
   for(auto& it : m_framebufferRegions)
   {
@@ -296,11 +281,65 @@ bool LogicalDisplay::start(vk::SurfaceFormatKHR swapchainSurfFormat, vk::RenderP
   return true;
 }
 
-void LogicalDisplay::renderFrameAsync(CommandExecutionUnit& cmdExecUnit)
+void LogicalDisplay::createSwapchain()
 {
+  // vk_ddisplay
+  // the swap chain should have as many images as there are queued frames, so that acquiring the next image doesn't
+  // block the queued frames. a maxImageCount of 0 means there is no limit
+  vk::PhysicalDevice         mainPhysicalDevice = this->findMainPhysicalDevice();
+  vk::SurfaceCapabilitiesKHR surfCaps           = mainPhysicalDevice.getSurfaceCapabilitiesKHR(m_surface.get());
+  uint32_t                   imageCount         = std::max(surfCaps.minImageCount, m_logicalDevice.getNumQueuedFrames());
+  if(surfCaps.maxImageCount != 0)
+  {
+    imageCount = std::min(imageCount, surfCaps.maxImageCount);
+  }
+  if(m_swapchain && imageCount == m_framebuffers.size())
+  {
+    return;
+  }
+
+  vk::DeviceGroupSwapchainCreateInfoKHR deviceGroupSwapchainCreateInfo(vk::DeviceGroupPresentModeFlagBitsKHR::eLocalMultiDevice);
+  vk::SwapchainCreateInfoKHR swapchainCreateInfo(
+      {}, m_surface.get(), imageCount, m_swapchainSurfFormat.format, m_swapchainSurfFormat.colorSpace, surfCaps.currentExtent,
+      1, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {},
+      surfCaps.currentTransform, vk::CompositeAlphaFlagBitsKHR::eOpaque, m_presentMode, true, m_swapchain.get(),
+      &deviceGroupSwapchainCreateInfo);
+  // the old swap chain is retired by the new one and destroyed right away, the caller ensures that it's not in use
+  m_framebuffers.clear();
+  m_swapchainImageViews.clear();
+  m_swapchain = m_logicalDevice.vkDevice().createSwapchainKHRUnique(swapchainCreateInfo);
+  LOGI("Created swap chain with %u images.\n", imageCount);
+
+  for(vk::Image swapchainImage : m_logicalDevice.vkDevice().getSwapchainImagesKHR(m_swapchain.get()))
+  {
+    vk::ImageViewCreateInfo swapchainImageViewCreateInfo({}, swapchainImage, vk::ImageViewType::e2D, m_swapchainSurfFormat.format,
+                                                         {vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity,
+                                                          vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity},
+                                                         vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    m_swapchainImageViews.emplace_back(m_logicalDevice.vkDevice().createImageViewUnique(swapchainImageViewCreateInfo));
+    std::vector<vk::ImageView> framebufferAttachments = {m_swapchainImageViews.back().get(), m_depthStencilImageView.get()};
+    vk::FramebufferCreateInfo frameBufferCreateInfo({}, m_renderPass, framebufferAttachments,
+                                                    surfCaps.currentExtent.width, surfCaps.currentExtent.height, 1);
+    m_framebuffers.emplace_back(m_logicalDevice.vkDevice().createFramebufferUnique(frameBufferCreateInfo));
+  }
+}
+
+void LogicalDisplay::resizeFrameRings()
+{
+  this->createSwapchain();
+  for(UniqueCanvasRegionRenderThread const& rt : m_canvasRegionsRenderThreads)
+  {
+    rt->resizeFrameRings();
+  }
+}
+
+void LogicalDisplay::renderFrameAsync(CommandExecutionUnit& cmdExecUnit, SceneSnapshot const& scene, bool useSecondaryCmdBuffers)
+{
+  m_useSecondaryCmdBuffers = useSecondaryCmdBuffers;
+
   // first the next swap chain image is acquired
   vk::Semaphore imageAcquiredSemaphore =
-      m_imageAcquiredSemaphores[m_logicalDevice.getCurrentFrameIndex() % NUM_QUEUED_FRAMES].get();
+      m_imageAcquiredSemaphores[m_logicalDevice.getCurrentFrameSlot()].get();
   vk::AcquireNextImageInfoKHR acquireNextImageInfo(m_swapchain.get(), std::numeric_limits<uint64_t>::max(),
                                                    imageAcquiredSemaphore, {}, m_deviceMask);
   vk::ResultValue             rv = m_logicalDevice.vkDevice().acquireNextImage2KHR(acquireNextImageInfo);
@@ -321,7 +360,7 @@ void LogicalDisplay::renderFrameAsync(CommandExecutionUnit& cmdExecUnit)
   cmdExecUnit.pushWait(m_preRenderCmdBuffer, {imageAcquiredSemaphore, 0, vk::PipelineStageFlagBits2::eColorAttachmentOutput});
   for(UniqueCanvasRegionRenderThread const& rt : m_canvasRegionsRenderThreads)
   {
-    rt->recordCommandsAsync(cmdExecUnit, m_framebuffers[m_lastAcquiredSwapchainImageIdx].get());
+    rt->recordCommandsAsync(cmdExecUnit, scene, m_framebuffers[m_lastAcquiredSwapchainImageIdx].get(), m_useSecondaryCmdBuffers);
     cmdExecUnit.pushSignal(m_preRenderCmdBuffer,
                            {rt->getImageAcquiredSemaphore(), 0, vk::PipelineStageFlagBits2::eEarlyFragmentTests, 0});
   }
@@ -351,6 +390,10 @@ std::optional<LogicalDisplay::PresentData> LogicalDisplay::finishFrameRendering(
   {
     rt->finishCommandRecording();
   }
+  if(m_useSecondaryCmdBuffers)
+  {
+    this->executeRenderThreadCommands(cmdExecUnit);
+  }
   // the post render cmd buffer will wait for all render contexts to finish rendering, transition the swap chain image
   // to the present layout, and signal the present semaphore
   // in order to show a preview image in the control window, the swap chain image might be transfered to a separate
@@ -386,6 +429,55 @@ std::optional<LogicalDisplay::PresentData> LogicalDisplay::finishFrameRendering(
   return PresentData{m_readyToPresentSem.get(), m_swapchain.get(), m_lastAcquiredSwapchainImageIdx};
 }
 
+void LogicalDisplay::executeRenderThreadCommands(CommandExecutionUnit& cmdExecUnit)
+{
+  // vk_ddisplay
+  // there is a single render pass for each device, which executes the secondary command buffers of all render threads
+  // of that device. its render area covers all of their render areas, so the attachments are cleared only once
+  for(auto const& it : m_framebufferRegions)
+  {
+    DeviceIndex                    devIdx = it.first;
+    std::vector<vk::CommandBuffer> secondaryCmdBuffers;
+    std::optional<Vec3f>           clearColor;
+    int32_t                        minX = std::numeric_limits<int32_t>::max();
+    int32_t                        maxX = std::numeric_limits<int32_t>::min();
+    int32_t                        minY = std::numeric_limits<int32_t>::max();
+    int32_t                        maxY = std::numeric_limits<int32_t>::min();
+    for(UniqueCanvasRegionRenderThread const& rt : m_canvasRegionsRenderThreads)
+    {
+      if(rt->getDeviceIndex() != devIdx || !rt->getSecondaryCommandBuffer())
+      {
+        continue;
+      }
+      secondaryCmdBuffers.emplace_back(rt->getSecondaryCommandBuffer());
+      // the clear color of the first render thread is used for the whole render area
+      clearColor            = clearColor.value_or(rt->getLastClearColor());
+      vk::Rect2D renderArea = rt->getRenderArea();
+      minX                  = std::min(minX, renderArea.offset.x);
+      maxX                  = std::max(maxX, renderArea.offset.x + (int32_t)renderArea.extent.width);
+      minY                  = std::min(minY, renderArea.offset.y);
+      maxY                  = std::max(maxY, renderArea.offset.y + (int32_t)renderArea.extent.height);
+    }
+    if(secondaryCmdBuffers.empty())
+    {
+      continue;
+    }
+    vk::CommandBuffer cmdBuffer =
+        cmdExecUnit.requestCommandBuffer(m_logicalDevice.getGraphicsQueueFamilyIndex(), DeviceMask::ofSingleDevice(devIdx));
+    vk::ClearColorValue         clearColorValue(clearColor.value().x, clearColor.value().y, clearColor.value().z, 1.0f);
+    vk::ClearDepthStencilValue  clearDepthStencil(1.0f, 0U);
+    std::vector<vk::ClearValue> clearValues = {clearColorValue, clearDepthStencil};
+    vk::Rect2D                  renderArea{{minX, minY}, {(uint32_t)(maxX - minX), (uint32_t)(maxY - minY)}};
+    vk::RenderPassBeginInfo     renderPassBegin(m_logicalDevice.getDonutRenderPass(),
+                                                m_framebuffers[m_lastAcquiredSwapchainImageIdx].get(), renderArea, clearValues);
+    cmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    cmdBuffer.beginRenderPass(renderPassBegin, vk::SubpassContents::eSecondaryCommandBuffers);
+    cmdExecUnit.executeCommands(cmdBuffer, secondaryCmdBuffers);
+    cmdBuffer.endRenderPass();
+    cmdBuffer.end();
+  }
+}
+
 void LogicalDisplay::storeFramebuffer(CommandExecutionUnit const& cmdExecUnit, uint32_t transferQueueFamilyIdx) {}
 
 void LogicalDisplay::copyFramebufferToHost(vk::CommandBuffer cmdBuffer, vk::Buffer dstBuffer) {}
@@ -46,15 +46,18 @@ public:
   LogicalDisplay(class LogicalDevice& logicalDevice, vk::DisplayKHR display, CanvasRegion displayRegionOnCanvas);
   ~LogicalDisplay();
 
-  [[nodiscard]] bool init(class Scene const& scene, std::vector<DeviceIndex> const& deviceIndices);
+  [[nodiscard]] bool init(std::vector<DeviceIndex> const& deviceIndices);
   vk::DisplayKHR     getDisplay() const { return m_display; }
   vk::SwapchainKHR   getSwapchain() const { return m_swapchain.get(); }
   DeviceMask const&  getDeviceMask() const { return m_deviceMask; }
   void               querySurfaceFormats(std::vector<vk::SurfaceFormatKHR>& formats) const;
 
   [[nodiscard]] bool         start(vk::SurfaceFormatKHR swapchainSurfFormat, vk::RenderPass renderPass);
-  void                       renderFrameAsync(class CommandExecutionUnit& cmdExecUnit);
+  // the render threads read the snapshot until finishFrameRendering() returns
+  void                       renderFrameAsync(class CommandExecutionUnit& cmdExecUnit, struct SceneSnapshot const& scene, bool useSecondaryCmdBuffers);
   std::optional<PresentData> finishFrameRendering(CommandExecutionUnit& cmdExecUnit);
+  // adapts the swap chain and the render threads to a changed number of queued frames, the device must be idle
+  void                       resizeFrameRings();
   void                       copyFramebufferToHost(vk::CommandBuffer cmdBuffer, vk::Buffer dstBuffer);
 
   uint32_t                  getNumRenderThreads() const { return (uint32_t)m_canvasRegionsRenderThreads.size(); }
@@ -80,7 +83,10 @@ private:
   vk::Extent2D                                        m_surfaceSize;
   vk::UniqueSurfaceKHR                                m_surface;
   vk::UniqueSwapchainKHR                              m_swapchain;
-  std::array<vk::UniqueSemaphore, NUM_QUEUED_FRAMES>  m_imageAcquiredSemaphores;
+  vk::SurfaceFormatKHR                                m_swapchainSurfFormat;
+  vk::PresentModeKHR                                  m_presentMode;
+  vk::RenderPass                                      m_renderPass;
+  std::array<vk::UniqueSemaphore, MAX_QUEUED_FRAMES>  m_imageAcquiredSemaphores;
   vk::CommandBuffer                                   m_preRenderCmdBuffer;
   vk::UniqueSemaphore                                 m_readyToPresentSem;
   std::vector<vk::UniqueImageView>                    m_swapchainImageViews;
@@ -91,9 +97,12 @@ private:
   vk::Image                                           m_lastAcquiredSwapchainImage;
   std::unordered_map<DeviceIndex, FramebufferRegions> m_framebufferRegions;
   BufferAllocation                                    m_hostFramebufferCopy;
+  bool                                                m_useSecondaryCmdBuffers;
 
   vk::PhysicalDevice findMainPhysicalDevice() const;
-  void               pushRenderContext(Scene const& scene, DeviceIndex deviceIndex);
+  void               createSwapchain();
+  void               pushRenderContext(DeviceIndex deviceIndex);
+  void               executeRenderThreadCommands(CommandExecutionUnit& cmdExecUnit);
   void               storeFramebuffer(CommandExecutionUnit const& cmdExecUnit, uint32_t transferQueueFamilyIdx);
 };
 }  // namespace vkdd
\ No newline at end of file
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "render_graph.hpp"
+
+#include "command_execution_unit.hpp"
+#include "logical_device.hpp"
+
+namespace vkdd {
+// each queue family used by the graph has its own timeline semaphore, so that the signaled values only increase in the
+// submission order of that queue
+struct QueueTimeline
+{
+  vk::UniqueSemaphore m_semaphore;
+  uint64_t            m_value;
+  // the highest value and its stages this queue already waited on, for each producing queue family
+  std::unordered_map<uint32_t, std::pair<uint64_t, vk::PipelineStageFlags2>> m_waited;
+};
+
+// a semaphore wait of a pass on a pass of another queue, which may belong to a previous frame
+struct PassDependency
+{
+  uint32_t                m_queueFamilyIndex;
+  size_t                  m_passIndex;
+  uint64_t                m_timelineValue;
+  vk::PipelineStageFlags2 m_dstStages;
+};
+
+struct Pass
+{
+  uint32_t                                 m_queueFamilyIndex;
+  std::vector<RenderGraph::ResourceAccess> m_accesses;
+  RenderGraph::RecordFunc                  m_record;
+  std::vector<vk::BufferMemoryBarrier2>    m_barriers;
+  std::vector<vk::BufferMemoryBarrier2>    m_releaseBarriers;
+  std::vector<PassDependency>              m_dependencies;
+  bool                                     m_signal;
+  uint64_t                                 m_signalValue;
+  // the value of the first signal of this queue at or after this pass
+  uint64_t m_completionValue;
+};
+
+void RenderGraph::BufferResource::setRange(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size)
+{
+  if(m_buffer != buffer || m_offset != offset)
+  {
+    m_buffer = buffer;
+    m_offset = offset;
+    m_lastWrite.reset();
+    m_readsSinceLastWrite.clear();
+  }
+  m_size = size;
+}
+
+RenderGraph::ResourceAccess RenderGraph::read(BufferResource& resource, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access)
+{
+  return {&resource, stages, access, false};
+}
+
+RenderGraph::ResourceAccess RenderGraph::write(BufferResource& resource, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access)
+{
+  return {&resource, stages, access, true};
+}
+
+RenderGraph::RenderGraph(LogicalDevice& logicalDevice)
+    : m_logicalDevice(logicalDevice)
+{
+}
+
+RenderGraph::~RenderGraph() {}
+
+QueueTimeline& RenderGraph::getQueueTimeline(uint32_t queueFamilyIndex)
+{
+  QueueTimeline& timeline = m_queueTimelines[queueFamilyIndex];
+  if(!timeline.m_semaphore)
+  {
+    vk::SemaphoreTypeCreateInfo semType(vk::SemaphoreType::eTimeline, 0);
+    timeline.m_semaphore = m_logicalDevice.vkDevice().createSemaphoreUnique({{}, &semType});
+    timeline.m_value     = 0;
+  }
+  return timeline;
+}
+
+void RenderGraph::addPass(uint32_t queueFamilyIndex, std::vector<ResourceAccess> accesses, RecordFunc record)
+{
+  m_passes.push_back({queueFamilyIndex, std::move(accesses), std::move(record), {}, {}, {}, false, 0, 0});
+}
+
+void RenderGraph::addHazard(size_t passIndex, BufferResource::Access const& producer, bool producerWrote, ResourceAccess const& consumer)
+{
+  // accesses within a single pass are synchronized by the pass itself
+  if(producer.m_passIndex == passIndex)
+  {
+    return;
+  }
+  Pass&                 pass      = m_passes[passIndex];
+  BufferResource const& resource  = *consumer.m_resource;
+  vk::AccessFlags2      srcAccess = producerWrote ? producer.m_access : vk::AccessFlagBits2::eNone;
+  if(producer.m_queueFamilyIndex == pass.m_queueFamilyIndex)
+  {
+    // on the same queue a barrier is enough, it also covers previous frames' submissions
+    pass.m_barriers.emplace_back(producer.m_stages, srcAccess, consumer.m_stages, consumer.m_access, VK_QUEUE_FAMILY_IGNORED,
+                                 VK_QUEUE_FAMILY_IGNORED, resource.m_buffer, resource.m_offset, resource.m_size);
+    return;
+  }
+  if(producerWrote && !consumer.m_write)
+  {
+    // the contents are read by another queue family, which requires an ownership transfer
+    if(producer.m_passIndex != NO_PASS)
+    {
+      m_passes[producer.m_passIndex].m_releaseBarriers.emplace_back(
+          producer.m_stages, producer.m_access, vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+          producer.m_queueFamilyIndex, pass.m_queueFamilyIndex, resource.m_buffer, resource.m_offset, resource.m_size);
+      pass.m_barriers.emplace_back(vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, consumer.m_stages,
+                                   consumer.m_access, producer.m_queueFamilyIndex, pass.m_queueFamilyIndex,
+                                   resource.m_buffer, resource.m_offset, resource.m_size);
+    }
+    else
+    {
+      LOGW("Resource written in a previous frame is read by another queue family without ownership transfer.\n");
+    }
+  }
+  if(producer.m_passIndex != NO_PASS)
+  {
+    m_passes[producer.m_passIndex].m_signal = true;
+  }
+  pass.m_dependencies.push_back({producer.m_queueFamilyIndex, producer.m_passIndex, producer.m_timelineValue, consumer.m_stages});
+}
+
+void RenderGraph::compile()
+{
+  for(size_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+  {
+    for(ResourceAccess const& access : m_passes[passIndex].m_accesses)
+    {
+      BufferResource& resource = *access.m_resource;
+      if(std::find(m_touchedResources.begin(), m_touchedResources.end(), &resource) == m_touchedResources.end())
+      {
+        m_touchedResources.emplace_back(&resource);
+      }
+      BufferResource::Access current = {m_passes[passIndex].m_queueFamilyIndex, access.m_stages, access.m_access, passIndex, 0};
+      if(access.m_write)
+      {
+        // a write has to wait for all reads since the last write, or for the last write if there were no reads
+        if(resource.m_readsSinceLastWrite.empty() && resource.m_lastWrite.has_value())
+        {
+          this->addHazard(passIndex, resource.m_lastWrite.value(), true, access);
+        }
+        for(BufferResource::Access const& readAccess : resource.m_readsSinceLastWrite)
+        {
+          this->addHazard(passIndex, readAccess, false, access);
+        }
+        resource.m_lastWrite = current;
+        resource.m_readsSinceLastWrite.clear();
+      }
+      else
+      {
+        if(resource.m_lastWrite.has_value())
+        {
+          this->addHazard(passIndex, resource.m_lastWrite.value(), true, access);
+        }
+        resource.m_readsSinceLastWrite.emplace_back(current);
+      }
+    }
+  }
+
+  // the last pass of each queue always signals, so that the next frame can synchronize with any of its passes
+  std::unordered_map<uint32_t, uint64_t> nextSignalValue;
+  for(auto it = m_passes.rbegin(); it != m_passes.rend(); ++it)
+  {
+    it->m_signal |= nextSignalValue.find(it->m_queueFamilyIndex) == nextSignalValue.end();
+    nextSignalValue[it->m_queueFamilyIndex] = 0;
+  }
+  for(Pass& pass : m_passes)
+  {
+    if(pass.m_signal)
+    {
+      pass.m_signalValue = ++this->getQueueTimeline(pass.m_queueFamilyIndex).m_value;
+    }
+  }
+  for(auto it = m_passes.rbegin(); it != m_passes.rend(); ++it)
+  {
+    if(it->m_signal)
+    {
+      nextSignalValue[it->m_queueFamilyIndex] = it->m_signalValue;
+    }
+    it->m_completionValue = nextSignalValue[it->m_queueFamilyIndex];
+  }
+}
+
+void RenderGraph::execute(CommandExecutionUnit& cmdExecUnit, DeviceIndex deviceIndex)
+{
+  this->compile();
+  for(Pass& pass : m_passes)
+  {
+    vk::CommandBuffer cmdBuffer = cmdExecUnit.requestCommandBuffer(pass.m_queueFamilyIndex, DeviceMask::ofSingleDevice(deviceIndex));
+    PassContext       context   = {cmdBuffer, cmdBuffer};
+
+    // a single wait per producing queue, unless a previous pass of this queue already waited for it
+    QueueTimeline& timeline = this->getQueueTimeline(pass.m_queueFamilyIndex);
+    std::unordered_map<uint32_t, std::pair<uint64_t, vk::PipelineStageFlags2>> waits;
+    for(PassDependency const& dependency : pass.m_dependencies)
+    {
+      uint64_t value = dependency.m_passIndex != NO_PASS ? m_passes[dependency.m_passIndex].m_completionValue :
+                                                           dependency.m_timelineValue;
+      auto     waitedIt = timeline.m_waited.find(dependency.m_queueFamilyIndex);
+      if(waitedIt != timeline.m_waited.end() && value <= waitedIt->second.first
+         && (dependency.m_dstStages & ~waitedIt->second.second) == vk::PipelineStageFlags2())
+      {
+        continue;
+      }
+      auto& wait  = waits[dependency.m_queueFamilyIndex];
+      wait.first  = std::max(wait.first, value);
+      wait.second = wait.second | dependency.m_dstStages;
+    }
+    for(auto const& it : waits)
+    {
+      cmdExecUnit.pushWait(cmdBuffer, {this->getQueueTimeline(it.first).m_semaphore.get(), it.second.first, it.second.second, deviceIndex});
+      auto& waited = timeline.m_waited[it.first];
+      waited       = waited.first == it.second.first ? std::make_pair(waited.first, waited.second | it.second.second) : it.second;
+    }
+
+    cmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    if(!pass.m_barriers.empty())
+    {
+      cmdBuffer.pipelineBarrier2({vk::DependencyFlagBits::eByRegion, {}, pass.m_barriers, {}});
+    }
+    pass.m_record(context);
+    if(!pass.m_releaseBarriers.empty())
+    {
+      cmdBuffer.pipelineBarrier2({vk::DependencyFlagBits::eByRegion, {}, pass.m_releaseBarriers, {}});
+    }
+    cmdBuffer.end();
+    if(pass.m_signal)
+    {
+      cmdExecUnit.pushSignal(context.m_signalCmdBuffer, {timeline.m_semaphore.get(), pass.m_signalValue,
+                                                         vk::PipelineStageFlagBits2::eAllCommands, deviceIndex});
+    }
+  }
+
+  // the accesses of this frame are remembered by the values which will be signaled after them
+  for(BufferResource* resource : m_touchedResources)
+  {
+    std::vector<BufferResource::Access*> accesses;
+    if(resource->m_lastWrite.has_value())
+    {
+      accesses.emplace_back(&resource->m_lastWrite.value());
+    }
+    for(BufferResource::Access& readAccess : resource->m_readsSinceLastWrite)
+    {
+      accesses.emplace_back(&readAccess);
+    }
+    for(BufferResource::Access* access : accesses)
+    {
+      if(access->m_passIndex != NO_PASS)
+      {
+        access->m_timelineValue = m_passes[access->m_passIndex].m_completionValue;
+        access->m_passIndex     = NO_PASS;
+      }
+    }
+  }
+  m_touchedResources.clear();
+  m_passes.clear();
+}
+}  // namespace vkdd
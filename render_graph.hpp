@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "vkdd.hpp"
+
+#include <functional>
+
+namespace vkdd {
+// vk_ddisplay
+// a render graph collects the passes a render thread records in a frame, e.g. an instance copy on the transfer queue
+// and a draw on the graphics queue. each pass declares the buffer ranges it reads and writes, and the graph derives the
+// pipeline barriers, the queue family ownership transfers, and the timeline semaphore waits between the passes
+// * barriers needed before a pass are merged into a single pipelineBarrier2() call
+// * a pass only waits on the passes it depends on, with the stages of its accesses, and waits already covered by a
+//   previous pass of the same queue are dropped
+// * writes are assumed to overwrite the whole range, so only reads require an ownership transfer
+// the access state of a resource is kept across frames, so the first pass of a frame synchronizes with the last pass of
+// a previous frame that accessed the resource. ownership transfers can't be recorded into the previous frame though, a
+// resource moving to another queue family across frames must be written first
+class RenderGraph
+{
+public:
+  // a buffer range whose accesses are tracked by a render graph, owned by the user of the graph
+  class BufferResource
+  {
+  public:
+    // moving the range to another buffer or offset drops the access state, the previous range must not be in use
+    // anymore. the size may change at any time
+    void setRange(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size);
+
+  private:
+    friend class RenderGraph;
+
+    struct Access
+    {
+      uint32_t                m_queueFamilyIndex;
+      vk::PipelineStageFlags2 m_stages;
+      vk::AccessFlags2        m_access;
+      // index of the pass in the current frame or NO_PASS, then the timeline value signaled after the access
+      size_t   m_passIndex;
+      uint64_t m_timelineValue;
+    };
+
+    vk::Buffer            m_buffer = {};
+    vk::DeviceSize        m_offset = 0;
+    vk::DeviceSize        m_size   = 0;
+    std::optional<Access> m_lastWrite;
+    std::vector<Access>   m_readsSinceLastWrite;
+  };
+
+  struct ResourceAccess
+  {
+    BufferResource*         m_resource;
+    vk::PipelineStageFlags2 m_stages;
+    vk::AccessFlags2        m_access;
+    bool                    m_write;
+  };
+
+  // a pass records into m_cmdBuffer, the graph's semaphores are signaled after m_signalCmdBuffer, which may be changed
+  // to e.g. a secondary command buffer executed later in the frame
+  struct PassContext
+  {
+    vk::CommandBuffer m_cmdBuffer;
+    vk::CommandBuffer m_signalCmdBuffer;
+  };
+
+  typedef std::function<void(PassContext& context)> RecordFunc;
+
+  static ResourceAccess read(BufferResource& resource, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access);
+  static ResourceAccess write(BufferResource& resource, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access);
+
+  RenderGraph(class LogicalDevice& logicalDevice);
+  ~RenderGraph();
+
+  void addPass(uint32_t queueFamilyIndex, std::vector<ResourceAccess> accesses, RecordFunc record);
+  // records all passes added since the last call into command buffers of the given unit
+  void execute(class CommandExecutionUnit& cmdExecUnit, DeviceIndex deviceIndex);
+
+private:
+  static constexpr size_t NO_PASS = ~size_t(0);
+
+  LogicalDevice&                                     m_logicalDevice;
+  std::unordered_map<uint32_t, struct QueueTimeline> m_queueTimelines;
+  std::vector<struct Pass>                           m_passes;
+  std::vector<BufferResource*>                       m_touchedResources;
+
+  struct QueueTimeline& getQueueTimeline(uint32_t queueFamilyIndex);
+  void                  addHazard(size_t                        passIndex,
+                                  BufferResource::Access const& producer,
+                                  bool                          producerWrote,
+                                  ResourceAccess const&         consumer);
+  void                  compile();
+};
+}  // namespace vkdd
@@ -23,62 +23,103 @@
 
 namespace vkdd {
 RenderThread::RenderThread(class LogicalDevice& logicalDevice, DeviceIndex deviceIndex)
-    : m_status(Status::CREATED)
-    , m_logicalDevice(logicalDevice)
+    : m_logicalDevice(logicalDevice)
     , m_deviceIndex(deviceIndex)
     , m_systemPhysicalDeviceIndex((uint32_t)-1)
+    , m_numaNode(logicalDevice.getNumaNode(deviceIndex))
+    , m_recordingSlotIndex(logicalDevice.registerRecordingThread())
+    , m_currentCmdExecUnit(nullptr)
+    , m_currentScene(nullptr)
+    , m_currentUseSecondaryCmdBuffer(false)
 {
   std::vector<vk::PhysicalDevice> devices = m_logicalDevice.vkInstance().enumeratePhysicalDevices();
   m_systemPhysicalDeviceIndex =
       std::find(devices.begin(), devices.end(), m_logicalDevice.getPhysicalDevice(deviceIndex)) - devices.begin();
 }
 
+RenderThread::~RenderThread()
+{
+  m_logicalDevice.unregisterRecordingThread(m_recordingSlotIndex);
+}
+
 void RenderThread::start()
 {
   m_imageAcquiredSem = m_logicalDevice.vkDevice().createSemaphoreUnique({});
   m_renderDoneSem    = m_logicalDevice.vkDevice().createSemaphoreUnique({});
-  m_thread           = std::make_unique<std::thread>([this]() {
-    std::unique_lock lock(m_mtx);
-    while(m_status != Status::INTERRUPTED)
+  this->resizeFrameRings();
+}
+
+void RenderThread::recordCommandsAsync(class CommandExecutionUnit& cmdExecUnit,
+                                       struct SceneSnapshot const& scene,
+                                       vk::Framebuffer             framebuffer,
+                                       bool                        useSecondaryCmdBuffer)
+{
+  assert(m_recordingTask.isDone());
+  // the command execution unit has been waited for, therefore the GPU is done with this frame's staging arena
+  m_stagingArenas[m_logicalDevice.getCurrentFrameSlot()]->reset();
+  m_currentCmdExecUnit           = &cmdExecUnit;
+  m_currentScene                 = &scene;
+  m_currentFramebuffer           = framebuffer;
+  m_currentUseSecondaryCmdBuffer = useSecondaryCmdBuffer;
+  TaskPool::Task recordTask = [this]() {
+    // whichever thread picks up the task records into this render thread's slot of the command pools
+    RecordingSlotIndex prevSlotIndex = CommandExecutionUnit::bindRecordingSlot(m_recordingSlotIndex);
+    this->recordCommands(*m_currentCmdExecUnit, *m_currentScene, m_currentFramebuffer, m_currentUseSecondaryCmdBuffer);
+    CommandExecutionUnit::bindRecordingSlot(prevSlotIndex);
+  };
+  TaskPool::getShared().run(m_recordingTask, std::move(recordTask), m_numaNode);
+}
+
+StagingBufferRange RenderThread::allocateFrameStagingMemory(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+  std::optional<StagingBufferRange> range =
+      m_stagingArenas[m_logicalDevice.getCurrentFrameSlot()]->alloc(size, alignment);
+  return range.has_value() ? range.value() : m_logicalDevice.allocateFrameStagingMemory(size, alignment);
+}
+
+vk::DeviceSize RenderThread::getStagingHighWaterMark() const
+{
+  vk::DeviceSize highWaterMark = 0;
+  for(std::unique_ptr<LinearStagingArena> const& stagingArena : m_stagingArenas)
+  {
+    if(stagingArena)
     {
-      if(m_status == Status::RECORDING)
-      {
-        this->recordCommands(*m_currentCmdExecUnit, m_currentFramebuffer);
-      }
-      m_status = Status::WAITING;
-      m_cv.notify_all();
-      m_cv.wait(lock, [this]() { return m_status != Status::WAITING; });
+      highWaterMark = std::max(highWaterMark, stagingArena->getHighWaterMark());
     }
-  });
+  }
+  return highWaterMark;
 }
 
-void RenderThread::recordCommandsAsync(class CommandExecutionUnit& cmdExecUnit, vk::Framebuffer framebuffer)
+void RenderThread::resizeFrameRings()
 {
-  std::unique_lock lock(m_mtx);
-  m_currentCmdExecUnit = &cmdExecUnit;
-  m_currentFramebuffer = framebuffer;
-  m_status             = Status::RECORDING;
-  m_cv.notify_all();
+  for(uint32_t slot = 0; slot < MAX_QUEUED_FRAMES; ++slot)
+  {
+    if(slot < m_logicalDevice.getNumQueuedFrames())
+    {
+      if(!m_stagingArenas[slot])
+      {
+        m_stagingArenas[slot] = std::make_unique<LinearStagingArena>(m_logicalDevice, 1 << 20);
+      }
+    }
+    else
+    {
+      m_stagingArenas[slot].reset();
+    }
+  }
 }
 
 void RenderThread::finishCommandRecording()
 {
-  std::unique_lock lock(m_mtx);
-  if(m_status == Status::RECORDING)
-  {
-    m_cv.wait(lock, [this]() { return m_status == Status::WAITING; });
-  }
+  TaskPool::getShared().wait(m_recordingTask);
 }
 
 void RenderThread::interrupt()
 {
-  std::unique_lock lock(m_mtx);
-  m_status = Status::INTERRUPTED;
-  m_cv.notify_all();
+  // there is no thread to wake up, a pending recording simply runs to completion
 }
 
 void RenderThread::join()
 {
-  m_thread->join();
+  TaskPool::getShared().wait(m_recordingTask);
 }
 }  // namespace vkdd
@@ -20,47 +20,60 @@
 #pragma once
 #include "vkdd.hpp"
 
+#include "command_execution_unit.hpp"
+#include "linear_staging_arena.hpp"
+#include "task_pool.hpp"
+
 #include <functional>
-#include <thread>
 
 namespace vkdd {
+// each render thread owns a ring of staging arenas, one for each queued frame, so that recording threads never contend
+// on the allocation of staging memory
+// a render thread is not an OS thread of its own anymore: recordCommandsAsync() runs the recording as a task on the
+// shared task pool, and finishCommandRecording() joins that task while helping out with other pending tasks
+// the task is queued on a worker on the NUMA node of the render thread's physical device, so that the staging memory
+// is first written, and with a first-touch policy also allocated, close to the GPU
 class RenderThread
 {
 public:
   RenderThread(class LogicalDevice& logicalDevice, DeviceIndex deviceIndex);
+  virtual ~RenderThread();
 
   void start();
-  void recordCommandsAsync(class CommandExecutionUnit& cmdExecUnit, vk::Framebuffer framebuffer);
+  // the snapshot must stay unchanged until finishCommandRecording() returns
+  void recordCommandsAsync(class CommandExecutionUnit& cmdExecUnit, struct SceneSnapshot const& scene, vk::Framebuffer framebuffer, bool useSecondaryCmdBuffer);
   void finishCommandRecording();
+  // releases or creates the per-frame resources after the number of queued frames changed, no recording may be pending
+  virtual void resizeFrameRings();
   void interrupt();
   void join();
 
-  virtual void   recordCommands(class CommandExecutionUnit& cmdExecUnit, vk::Framebuffer framebuffer) = 0;
-  vk::Semaphore  getImageAcquiredSemaphore() const { return m_renderDoneSem.get(); }
-  vk::Semaphore  getRenderDoneSemaphore() const { return m_renderDoneSem.get(); }
-  LogicalDevice& getLogicalDevice() const { return m_logicalDevice; }
-  DeviceIndex    getDeviceIndex() const { return m_deviceIndex; }
-  uint32_t       getSystemPhysicalDeviceIndex() const { return m_systemPhysicalDeviceIndex; }
+  // with useSecondaryCmdBuffer the render commands are recorded into a secondary command buffer, which continues the
+  // render pass of its logical display
+  virtual void recordCommands(class CommandExecutionUnit& cmdExecUnit, struct SceneSnapshot const& scene, vk::Framebuffer framebuffer, bool useSecondaryCmdBuffer) = 0;
+  StagingBufferRange allocateFrameStagingMemory(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+  vk::DeviceSize     getStagingHighWaterMark() const;
+  vk::Semaphore      getImageAcquiredSemaphore() const { return m_renderDoneSem.get(); }
+  vk::Semaphore      getRenderDoneSemaphore() const { return m_renderDoneSem.get(); }
+  LogicalDevice&     getLogicalDevice() const { return m_logicalDevice; }
+  DeviceIndex        getDeviceIndex() const { return m_deviceIndex; }
+  uint32_t           getSystemPhysicalDeviceIndex() const { return m_systemPhysicalDeviceIndex; }
+  // the recording tasks prefer the task pool's workers on this node, if the workers are pinned
+  std::optional<uint32_t> getNumaNode() const { return m_numaNode; }
 
 private:
-  enum class Status
-  {
-    CREATED,
-    RECORDING,
-    WAITING,
-    INTERRUPTED
-  };
-
-  Status                       m_status;
-  LogicalDevice&               m_logicalDevice;
-  DeviceIndex                  m_deviceIndex;
-  uint32_t                     m_systemPhysicalDeviceIndex;
-  CommandExecutionUnit*        m_currentCmdExecUnit;
-  vk::Framebuffer              m_currentFramebuffer;
-  vk::UniqueSemaphore          m_imageAcquiredSem;
-  vk::UniqueSemaphore          m_renderDoneSem;
-  std::unique_ptr<std::thread> m_thread;
-  std::mutex                   m_mtx;
-  std::condition_variable      m_cv;
+  LogicalDevice&                                                     m_logicalDevice;
+  DeviceIndex                                                        m_deviceIndex;
+  uint32_t                                                           m_systemPhysicalDeviceIndex;
+  std::optional<uint32_t>                                            m_numaNode;
+  RecordingSlotIndex                                                 m_recordingSlotIndex;
+  CommandExecutionUnit*                                              m_currentCmdExecUnit;
+  SceneSnapshot const*                                               m_currentScene;
+  vk::Framebuffer                                                    m_currentFramebuffer;
+  bool                                                               m_currentUseSecondaryCmdBuffer;
+  vk::UniqueSemaphore                                                m_imageAcquiredSem;
+  vk::UniqueSemaphore                                                m_renderDoneSem;
+  std::array<std::unique_ptr<LinearStagingArena>, MAX_QUEUED_FRAMES> m_stagingArenas;
+  TaskGroup                                                          m_recordingTask;
 };
 }  // namespace vkdd
@@ -85,6 +85,18 @@ void Scene::update(float millis)
   }
 }
 
+void Scene::takeSnapshot(SceneSnapshot& snapshot) const
+{
+  snapshot.m_nodes.clear();
+  for(Node const& node : m_geometryNodes)
+  {
+    snapshot.m_nodes.push_back({node.createModel(), node.getId(), node.getNodeType()});
+  }
+  snapshot.m_view          = m_camera.m_view;
+  snapshot.m_proj          = m_camera.m_proj;
+  snapshot.m_runtimeMillis = m_runtimeMillis;
+}
+
 void Scene::collectVisibleNodes(vk::Viewport globalViewport, vk::Viewport localViewport, std::function<void(Node const& node)> onVisible) const
 {
   for(Node const& node : m_geometryNodes)
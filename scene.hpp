@@ -64,6 +64,8 @@ public:
   Scene();
 
   void update(float millis);
+  // the snapshot's node storage is reused, so that taking a snapshot every frame doesn't allocate
+  void takeSnapshot(struct SceneSnapshot& snapshot) const;
   void collectVisibleNodes(vk::Viewport globalViewport, vk::Viewport localViewport, std::function<void(Node const& node)> onVisible) const;
   PerspectiveCamera const& getCamera() const { return m_camera; }
   void                     setPerspectiveCamera(float aspect, Angle fov, float nearZ, float farZ);
@@ -89,4 +91,24 @@ private:
   void rebuild();
   void fillDonutPlane(float z, uint32_t numDonutsX, uint32_t numDonutsY);
 };
+
+// vk_ddisplay
+// a scene snapshot is a compact, read-only copy of everything the render threads need for recording a frame: the
+// nodes' model matrices, the camera, and the runtime. it is taken once per frame on the main thread, so the model
+// matrices are computed once instead of in every render thread, and all render threads read it without any locking
+// while the main thread keeps updating the scene
+struct SceneSnapshot
+{
+  struct Node
+  {
+    Mat4x4f         m_model;
+    uint32_t        m_id;
+    Scene::NodeType m_nodeType;
+  };
+
+  std::vector<Node> m_nodes;
+  Mat4x4f           m_view;
+  Mat4x4f           m_proj;
+  float             m_runtimeMillis = 0.0f;
+};
 }  // namespace vkdd
@@ -19,13 +19,29 @@
 
 #version 450
 
-layout(push_constant) uniform GlobalData
+// must match MAX_QUEUED_FRAMES and NO_LATE_LATCH_SLOT of the application
+#define MAX_QUEUED_FRAMES 8
+#define NO_LATE_LATCH_SLOT 0xFFFFFFFF
+
+struct GlobalData
 {
   mat4x4 m_view;
   mat4x4 m_proj;
   float  m_runtimeMillis;
-}
-g_data;
+  uint   m_lateLatchSlot;
+};
+
+layout(set = 0, binding = 0) uniform GlobalDataBlock
+{
+  GlobalData g_recordedData;
+};
+
+// in low-latency mode the global data is written by the host right before the frame is submitted, one slot per
+// queued frame
+layout(set = 0, binding = 1) uniform LateLatchedGlobalDataBlock
+{
+  GlobalData g_lateLatchedData[MAX_QUEUED_FRAMES];
+};
 
 layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vNormal;
@@ -44,8 +60,11 @@ layout(location = 4) out float fShellHeight;
 
 void main()
 {
+  GlobalData globalData = g_recordedData.m_lateLatchSlot == NO_LATE_LATCH_SLOT ?
+                              g_recordedData :
+                              g_lateLatchedData[g_recordedData.m_lateLatchSlot];
   vec4 worldPos = iModel * vec4(vPos + iExtrusion * normalize(vNormal), 1.0f);
-  gl_Position   = g_data.m_proj * g_data.m_view * worldPos;
+  gl_Position   = globalData.m_proj * globalData.m_view * worldPos;
   fPos          = worldPos.xyz / worldPos.w;
   fNormal       = (vec4(vNormal, 0.0f) * iInvModel).xyz;
   fTex          = vTex;
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "task_pool.hpp"
+
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace vkdd {
+// the pool and worker index of the current thread, if it is a worker thread
+static thread_local TaskPool* t_pool        = nullptr;
+static thread_local uint32_t  t_workerIndex = 0;
+
+static void spinPause(uint32_t iteration)
+{
+#if defined(_M_X64) || defined(__x86_64__)
+  _mm_pause();
+#endif
+  // back off to the scheduler now and then, in case the thread that is waited for does not have a core
+  if((iteration & 255) == 255)
+  {
+    std::this_thread::yield();
+  }
+}
+
+TaskPool& TaskPool::getShared()
+{
+  static TaskPool s_pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+  return s_pool;
+}
+
+TaskPool::TaskPool(uint32_t numWorkers, uint32_t spinIterations)
+    : m_nextWorker(0)
+    , m_numQueued(0)
+    , m_numParkedWorkers(0)
+    , m_numParkedWaiters(0)
+    , m_spinIterations(spinIterations)
+    , m_stopping(false)
+{
+  for(uint32_t workerIndex = 0; workerIndex < numWorkers; ++workerIndex)
+  {
+    m_workers.push_back(std::make_unique<Worker>());
+  }
+  // the workers are started after all deques exist, since they immediately start stealing
+  for(uint32_t workerIndex = 0; workerIndex < numWorkers; ++workerIndex)
+  {
+    m_workers[workerIndex]->m_thread = std::thread([this, workerIndex]() { this->workerMain(workerIndex); });
+  }
+}
+
+TaskPool::~TaskPool()
+{
+  {
+    std::unique_lock lock(m_mtx);
+    m_stopping = true;
+  }
+  m_workAvailableCv.notify_all();
+  for(std::unique_ptr<Worker>& worker : m_workers)
+  {
+    worker->m_thread.join();
+  }
+}
+
+void TaskPool::run(TaskGroup& group, Task task, std::optional<uint32_t> numaNode)
+{
+  group.m_numPending.fetch_add(1, std::memory_order_relaxed);
+  if(m_workers.empty())
+  {
+    // single hardware thread, run the task right away
+    task();
+    group.m_numPending.fetch_sub(1, std::memory_order_release);
+    return;
+  }
+
+  // the counter is bumped before pushing, so that it never drops below the number of queued tasks
+  uint32_t numWorkers  = uint32_t(m_workers.size());
+  uint32_t workerIndex = (t_pool == this) ? t_workerIndex : m_nextWorker.fetch_add(1) % numWorkers;
+  if(t_pool != this && numaNode.has_value())
+  {
+    for(uint32_t i = 0; i < numWorkers; ++i)
+    {
+      if(m_workers[(workerIndex + i) % numWorkers]->m_numaNode == numaNode)
+      {
+        workerIndex = (workerIndex + i) % numWorkers;
+        break;
+      }
+    }
+  }
+  m_numQueued.fetch_add(1);
+  {
+    std::unique_lock lock(m_workers[workerIndex]->m_mtx);
+    m_workers[workerIndex]->m_tasks.push_back({std::move(task), &group});
+  }
+  // spinning workers pick up the task on their own, the lock is only taken if some worker has parked
+  // a parking worker announces itself before it checks the queue, so either it sees the task or the task sees it
+  if(m_numParkedWorkers.load() != 0)
+  {
+    {
+      std::unique_lock lock(m_mtx);
+    }
+    m_workAvailableCv.notify_one();
+  }
+}
+
+void TaskPool::wait(TaskGroup& group)
+{
+  std::optional<uint32_t> workerIndex = (t_pool == this) ? std::optional<uint32_t>(t_workerIndex) : std::nullopt;
+  while(!group.isDone())
+  {
+    if(this->tryRunTask(workerIndex))
+    {
+      continue;
+    }
+    // the remaining tasks of the group are being executed by other threads, which usually finish soon
+    for(uint32_t i = 0; i < m_spinIterations && !group.isDone() && m_numQueued.load(std::memory_order_relaxed) == 0; ++i)
+    {
+      spinPause(i);
+    }
+    if(!group.isDone() && m_numQueued.load() == 0)
+    {
+      std::unique_lock lock(m_mtx);
+      m_numParkedWaiters.fetch_add(1);
+      m_taskDoneCv.wait(lock, [this, &group]() { return group.isDone() || m_numQueued.load() != 0; });
+      m_numParkedWaiters.fetch_sub(1);
+    }
+  }
+}
+
+void TaskPool::pinWorkersToCpus()
+{
+  // the cpu ids may have gaps and the process may be restricted to some of them
+  std::vector<uint32_t> cpus = getAvailableCpus();
+  if(cpus.empty())
+  {
+    LOGW("Failed to query the CPUs available to the process, task pool workers are not pinned.\n");
+    return;
+  }
+  for(uint32_t workerIndex = 0; workerIndex < m_workers.size(); ++workerIndex)
+  {
+    Worker&  worker = *m_workers[workerIndex];
+    uint32_t cpu    = cpus[(workerIndex + 1) % cpus.size()];
+    if(!setThreadAffinity(worker.m_thread, cpu))
+    {
+      LOGW("Failed to pin task pool worker %u to CPU %u.\n", workerIndex, cpu);
+      continue;
+    }
+    worker.m_numaNode = getNumaNodeOfCpu(cpu);
+  }
+}
+
+bool TaskPool::tryRunTask(std::optional<uint32_t> workerIndex)
+{
+  if(m_numQueued.load() == 0)
+  {
+    return false;
+  }
+
+  std::optional<QueuedTask> queuedTask;
+  uint32_t                  numWorkers = uint32_t(m_workers.size());
+  uint32_t                  firstIndex = workerIndex.has_value() ? workerIndex.value() : 0;
+  std::optional<uint32_t>   numaNode   = workerIndex.has_value() ? m_workers[workerIndex.value()]->m_numaNode : std::nullopt;
+  // the deques of the workers on the own NUMA node are searched first, so tasks stay close to the memory they write
+  for(uint32_t i = 0; i < 2 * numWorkers && !queuedTask.has_value(); ++i)
+  {
+    uint32_t victimIndex = (firstIndex + i) % numWorkers;
+    Worker&  victim      = *m_workers[victimIndex];
+    if((victim.m_numaNode == numaNode) != (i < numWorkers))
+    {
+      continue;
+    }
+    std::unique_lock lock(victim.m_mtx);
+    if(victim.m_tasks.empty())
+    {
+      continue;
+    }
+    // the own deque is used as a stack for locality, other deques are stolen from the opposite end
+    if(workerIndex.has_value() && victimIndex == workerIndex.value())
+    {
+      queuedTask = std::move(victim.m_tasks.back());
+      victim.m_tasks.pop_back();
+    }
+    else
+    {
+      queuedTask = std::move(victim.m_tasks.front());
+      victim.m_tasks.pop_front();
+    }
+    m_numQueued.fetch_sub(1);
+  }
+  if(!queuedTask.has_value())
+  {
+    return false;
+  }
+
+  queuedTask->m_task();
+  // the group must not be touched after the last decrement, its waiter may destroy it right away
+  if(queuedTask->m_group->m_numPending.fetch_sub(1) == 1 && m_numParkedWaiters.load() != 0)
+  {
+    {
+      std::unique_lock lock(m_mtx);
+    }
+    m_taskDoneCv.notify_all();
+  }
+  return true;
+}
+
+void TaskPool::workerMain(uint32_t workerIndex)
+{
+  t_pool        = this;
+  t_workerIndex = workerIndex;
+  while(true)
+  {
+    if(this->tryRunTask(workerIndex))
+    {
+      continue;
+    }
+    uint32_t i = 0;
+    for(; i < m_spinIterations && m_numQueued.load(std::memory_order_relaxed) == 0; ++i)
+    {
+      spinPause(i);
+    }
+    if(i < m_spinIterations)
+    {
+      continue;
+    }
+    std::unique_lock lock(m_mtx);
+    m_numParkedWorkers.fetch_add(1);
+    m_workAvailableCv.wait(lock, [this]() { return m_stopping || m_numQueued.load() != 0; });
+    m_numParkedWorkers.fetch_sub(1);
+    if(m_stopping && m_numQueued.load() == 0)
+    {
+      return;
+    }
+  }
+}
+}  // namespace vkdd
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include "vkdd.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace vkdd {
+// a task group counts the tasks that have been run but not finished yet, waiting for a group joins all of its tasks
+class TaskGroup
+{
+public:
+  TaskGroup()
+      : m_numPending(0)
+  {
+  }
+
+  bool isDone() const { return m_numPending.load() == 0; }
+
+private:
+  friend class TaskPool;
+
+  std::atomic<uint32_t> m_numPending;
+};
+
+// a work-stealing task pool with one worker thread for each hardware thread besides the main thread
+// every worker owns a deque of tasks: tasks run from a worker are pushed to and popped from the back of its own deque,
+// idle workers steal from the front of the other workers' deques, and tasks run from any other thread are distributed
+// over the deques round robin
+// a thread waiting for a task group executes pending tasks itself instead of blocking, so the main thread helps to
+// record while it joins the render threads
+// optionally the workers are pinned to one CPU each, then tasks can be run on the workers of a preferred NUMA node and
+// workers steal from the workers on their own node first
+// idle workers and waiters spin for a bounded time before they park on a condition variable, and producers only take
+// the mutex to notify when somebody has actually parked, so the per-frame handoff usually costs a few atomics
+class TaskPool
+{
+public:
+  typedef std::function<void()> Task;
+
+  // shared by all logical devices and displays
+  static TaskPool& getShared();
+
+  // a frame hands out a few dozen short tasks at most, so waiting threads spin for a few microseconds before parking,
+  // a parked thread makes the next handoff pay for a mutex round trip and a wakeup (see task_pool_benchmark)
+  static constexpr uint32_t DEFAULT_SPIN_ITERATIONS = 2048;
+
+  // with zero spin iterations idle threads park right away
+  explicit TaskPool(uint32_t numWorkers, uint32_t spinIterations = DEFAULT_SPIN_ITERATIONS);
+  ~TaskPool();
+
+  // the task is queued on a worker of the given NUMA node if there is one, tasks run from a worker stay on that worker
+  void     run(TaskGroup& group, Task task, std::optional<uint32_t> numaNode = {});
+  void     wait(TaskGroup& group);
+  // pins worker i to CPU i + 1, leaving CPU 0 to the main thread, no tasks may be queued or running
+  void     pinWorkersToCpus();
+  uint32_t getNumWorkers() const { return uint32_t(m_workers.size()); }
+
+private:
+  struct QueuedTask
+  {
+    Task       m_task;
+    TaskGroup* m_group;
+  };
+
+  struct Worker
+  {
+    std::mutex              m_mtx;
+    std::deque<QueuedTask>  m_tasks;
+    std::thread             m_thread;
+    std::optional<uint32_t> m_numaNode;
+  };
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::atomic<uint32_t>                m_nextWorker;
+  std::atomic<uint32_t>                m_numQueued;
+  std::atomic<uint32_t>                m_numParkedWorkers;
+  std::atomic<uint32_t>                m_numParkedWaiters;
+  uint32_t                             m_spinIterations;
+  bool                                 m_stopping;
+  std::mutex                           m_mtx;
+  std::condition_variable              m_workAvailableCv;
+  std::condition_variable              m_taskDoneCv;
+
+  bool tryRunTask(std::optional<uint32_t> workerIndex);
+  void workerMain(uint32_t workerIndex);
+};
+}  // namespace vkdd
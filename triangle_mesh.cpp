@@ -104,14 +104,16 @@ void TriangleMesh::buildBuffers(std::vector<uint32_t> const& indices, std::vecto
 {
   m_numIndices = (uint32_t)indices.size();
   vk::BufferCreateInfo indexBufferCreateInfo({}, indices.size() * sizeof(uint32_t),
-                                             vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                                             vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst
+                                                 | vk::BufferUsageFlagBits::eTransferSrc,
                                              vk::SharingMode::eExclusive, {});
   m_indexBuffer = m_logicalDevice.allocateBuffer(m_deviceIndex, indexBufferCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
   m_logicalDevice.getUploader().memcpyHost2Buffer(m_indexBuffer.m_buffer.get(), 0, indices.data(),
                                                   indices.size() * sizeof(uint32_t), vk::PipelineStageFlagBits2::eIndexInput);
 
   vk::BufferCreateInfo vertexBufferCreateInfo({}, vertices.size() * sizeof(DefaultVertex),
-                                              vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                                              vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst
+                                                  | vk::BufferUsageFlagBits::eTransferSrc,
                                               vk::SharingMode::eExclusive, {});
   m_vertexBuffer = m_logicalDevice.allocateBuffer(m_deviceIndex, vertexBufferCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
   m_logicalDevice.getUploader().memcpyHost2Buffer(m_vertexBuffer.m_buffer.get(), 0, vertices.data(),
@@ -119,4 +121,14 @@ void TriangleMesh::buildBuffers(std::vector<uint32_t> const& indices, std::vecto
                                                   vk::PipelineStageFlagBits2::eVertexAttributeInput);
   m_availableFrameIndex = m_logicalDevice.getCurrentFrameIndex() + 1;
 }
+
+void TriangleMesh::relocateBuffers()
+{
+  // the buffers can only be moved once their initial upload has finished
+  if(m_availableFrameIndex <= m_logicalDevice.getCurrentFrameIndex())
+  {
+    m_logicalDevice.relocateBuffer(m_vertexBuffer, m_deviceIndex, true);
+    m_logicalDevice.relocateBuffer(m_indexBuffer, m_deviceIndex, true);
+  }
+}
 }  // namespace vkdd
\ No newline at end of file
@@ -48,6 +48,7 @@ public:
   vk::Buffer getIndexBuffer() const { return m_indexBuffer.m_buffer.get(); }
   uint32_t   getNumIndices() const { return m_numIndices; }
   FrameIndex getAvailableFrameIndex() const { return m_availableFrameIndex; }
+  void       relocateBuffers();
 
 private:
   LogicalDevice&   m_logicalDevice;
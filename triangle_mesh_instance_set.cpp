@@ -27,10 +27,19 @@ namespace vkdd {
 TriangleMeshInstanceSet::TriangleMeshInstanceSet(LogicalDevice& logicalDevice, DeviceIndex deviceIndex)
     : m_logicalDevice(logicalDevice)
     , m_deviceIndex(deviceIndex)
+    , m_numGeneratedInstances(0)
+    , m_bufferIndex(0)
     , m_bufferCapacity(0)
 {
 }
 
+void TriangleMeshInstanceSet::beginInstanceCollection()
+{
+  m_instances.clear();
+  m_numGeneratedInstances = 0;
+  m_bufferIndex           = (m_bufferIndex + 1) % NUM_BUFFERS;
+}
+
 void TriangleMeshInstanceSet::pushInstance(uint32_t uniqueId, Mat4x4f const& model, float shellHeight, float extrusion)
 {
   m_instances.emplace_back(DefaultInstance{model, model.invert(), uniqueId, shellHeight, extrusion});
@@ -38,46 +47,32 @@ void TriangleMeshInstanceSet::pushInstance(uint32_t uniqueId, Mat4x4f const& mod
 
 void TriangleMeshInstanceSet::endInstanceCollection()
 {
-  if(m_bufferCapacity < m_instances.size())
+  uint32_t numInstances = this->getNumInstances();
+  if(m_bufferCapacity < numInstances)
   {
-    m_logicalDevice.scheduleForDeallocation(std::move(m_bufferAllocation));
-    m_bufferCapacity = std::max((uint32_t)m_instances.size(), std::max(16U, 2U * m_bufferCapacity));
-    vk::BufferCreateInfo instanceBufferCreateInfo({}, m_bufferCapacity * sizeof(DefaultInstance),
-                                                  vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst);
-    m_bufferAllocation =
-        m_logicalDevice.allocateBuffer(m_deviceIndex, instanceBufferCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    m_bufferCapacity = std::max(numInstances, std::max(16U, 2U * m_bufferCapacity));
+    for(BufferSuballocator::Range& bufferRange : m_bufferRanges)
+    {
+      m_logicalDevice.scheduleForDeallocation(std::move(bufferRange));
+      bufferRange = m_logicalDevice.allocateInstanceBufferRange(m_deviceIndex, m_bufferCapacity * sizeof(DefaultInstance));
+    }
   }
 }
 
-void TriangleMeshInstanceSet::updateDeviceMemory(vk::CommandBuffer transferCmdBuffer, vk::CommandBuffer graphicsCmdBuffer)
+void TriangleMeshInstanceSet::updateDeviceMemory(vk::CommandBuffer transferCmdBuffer, StagingBufferRange staging)
 {
-  BufferAllocation allocation = m_logicalDevice.allocateStagingBuffer(
-      {{}, m_instances.size() * sizeof(DefaultInstance), vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {}});
-  memcpy(allocation.m_allocation.mappedMem(), m_instances.data(), m_instances.size() * sizeof(DefaultInstance));
-  vk::BufferCopy copy(0, 0, m_instances.size() * sizeof(DefaultInstance));
-  transferCmdBuffer.copyBuffer(allocation.m_buffer.get(), m_bufferAllocation.m_buffer.get(), copy);
-  vk::BufferMemoryBarrier2 releaseFromTransferBarrier(
-      vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eMemoryWrite, vk::PipelineStageFlagBits2::eCopy,
-      vk::AccessFlagBits2::eNone, m_logicalDevice.getTransferQueueFamilyIndex(), m_logicalDevice.getGraphicsQueueFamilyIndex(),
-      m_bufferAllocation.m_buffer.get(), 0, m_instances.size() * sizeof(DefaultInstance));
-  transferCmdBuffer.pipelineBarrier2({vk::DependencyFlagBits::eByRegion, {}, releaseFromTransferBarrier, {}});
-
-  vk::BufferMemoryBarrier2 acquireByGraphicsBarrier(
-      vk::PipelineStageFlagBits2::eVertexAttributeInput, vk::AccessFlagBits2::eNone,
-      vk::PipelineStageFlagBits2::eVertexAttributeInput, vk::AccessFlagBits2::eMemoryRead,
-      m_logicalDevice.getTransferQueueFamilyIndex(), m_logicalDevice.getGraphicsQueueFamilyIndex(),
-      m_bufferAllocation.m_buffer.get(), 0, m_instances.size() * sizeof(DefaultInstance));
-  graphicsCmdBuffer.pipelineBarrier2({vk::DependencyFlagBits::eByRegion, {}, acquireByGraphicsBarrier, {}});
-  m_logicalDevice.scheduleForDeallocation(std::move(allocation));
+  memcpy(staging.m_mapped, m_instances.data(), m_instances.size() * sizeof(DefaultInstance));
+  vk::BufferCopy copy(staging.m_offset, this->getBufferOffset(), m_instances.size() * sizeof(DefaultInstance));
+  transferCmdBuffer.copyBuffer(staging.m_buffer, this->getBuffer(), copy);
 }
 
 void TriangleMeshInstanceSet::draw(vk::CommandBuffer cmdBuffer, TriangleMesh& triangleMesh)
 {
-  if(!m_instances.empty())
+  if(this->getNumInstances() != 0)
   {
     cmdBuffer.bindVertexBuffers(0, {triangleMesh.getVertexBuffer(), this->getBuffer()}, {0, this->getBufferOffset()});
     cmdBuffer.bindIndexBuffer(triangleMesh.getIndexBuffer(), 0, vk::IndexType::eUint32);
-    cmdBuffer.drawIndexed(triangleMesh.getNumIndices(), (uint32_t)m_instances.size(), 0, 0, 0);
+    cmdBuffer.drawIndexed(triangleMesh.getNumIndices(), this->getNumInstances(), 0, 0, 0);
   }
 }
 }  // namespace vkdd
\ No newline at end of file
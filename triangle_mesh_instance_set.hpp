@@ -20,7 +20,8 @@
 #pragma once
 #include "vkdd.hpp"
 
-#include "buffer_allocation.hpp"
+#include "buffer_suballocator.hpp"
+#include "linear_staging_arena.hpp"
 
 namespace vkdd {
 
@@ -33,26 +34,48 @@ struct DefaultInstance
   float    m_extrusion;
 };
 
+// input of the instance expansion compute shader, one per node, matches the std430 layout of the shader's node buffer
+struct NodeTransform
+{
+  Mat4x4f  m_model;
+  uint32_t m_uniqueId;
+  uint32_t m_padding[3];
+};
+
+// vk_ddisplay
+// the instances are either collected on the CPU and copied to the device, or only counted here and generated on the
+// device by the instance expansion compute shader. the instance buffer is double buffered, so that the instances of
+// the next frame can be written while the current frame still reads the previous ones
+
 class TriangleMeshInstanceSet
 {
 public:
+  static constexpr uint32_t NUM_BUFFERS = 2;
+
   TriangleMeshInstanceSet(class LogicalDevice& logicalDevice, DeviceIndex deviceIndex);
 
-  vk::Buffer     getBuffer() const { return m_bufferAllocation.m_buffer.get(); }
-  vk::DeviceSize getBufferOffset() const { return 0; }
-  vk::DeviceSize getBufferSize() const { return m_instances.size() * sizeof(DefaultInstance); }
-  void           beginInstanceCollection() { m_instances.clear(); }
+  vk::Buffer     getBuffer() const { return m_bufferRanges[m_bufferIndex].buffer(); }
+  vk::DeviceSize getBufferOffset() const { return m_bufferRanges[m_bufferIndex].offset(); }
+  vk::DeviceSize getBufferSize() const { return this->getNumInstances() * sizeof(DefaultInstance); }
+  // index of the buffer written and read in the current frame, alternates with each instance collection
+  uint32_t       getBufferIndex() const { return m_bufferIndex; }
+  void           beginInstanceCollection();
   void           pushInstance(uint32_t uniqueId, Mat4x4f const& model, float shellHeight, float extrusion);
+  // reserves instances which are written to the instance buffer by the device, must not be mixed with pushInstance()
+  void           pushGeneratedInstances(uint32_t numInstances) { m_numGeneratedInstances += numInstances; }
   void           endInstanceCollection();
-  uint32_t       getNumInstances() const { return (uint32_t)m_instances.size(); }
-  void           updateDeviceMemory(vk::CommandBuffer transferCmdBuffer, vk::CommandBuffer graphicsCmdBuffer);
+  uint32_t       getNumInstances() const { return (uint32_t)m_instances.size() + m_numGeneratedInstances; }
+  // only records the copy, the synchronization of the instance buffer is up to the caller
+  void           updateDeviceMemory(vk::CommandBuffer transferCmdBuffer, StagingBufferRange staging);
   void           draw(vk::CommandBuffer cmdBuffer, class TriangleMesh& triangleMesh);
 
 private:
-  LogicalDevice&               m_logicalDevice;
-  DeviceIndex                  m_deviceIndex;
-  std::vector<DefaultInstance> m_instances;
-  BufferAllocation             m_bufferAllocation;
-  uint32_t                     m_bufferCapacity;
+  LogicalDevice&                                     m_logicalDevice;
+  DeviceIndex                                        m_deviceIndex;
+  std::vector<DefaultInstance>                       m_instances;
+  uint32_t                                           m_numGeneratedInstances;
+  std::array<BufferSuballocator::Range, NUM_BUFFERS> m_bufferRanges;
+  uint32_t                                           m_bufferIndex;
+  uint32_t                                           m_bufferCapacity;
 };
 }  // namespace vkdd
\ No newline at end of file
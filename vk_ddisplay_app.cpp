@@ -22,6 +22,7 @@
 #include "canvas_region_render_thread.hpp"
 #include "logical_device.hpp"
 #include "logical_display.hpp"
+#include "task_pool.hpp"
 
 #include <backends/imgui_impl_glfw.h>
 #include <imgui/backends/imgui_impl_gl.h>
@@ -39,6 +40,30 @@ VkDDisplayApp::VkDDisplayApp(vk::UniqueInstance instance)
   m_parameterList.add("config|Path to the json file containing the ddisplay configuration", &m_configPath);
   m_parameterList.add("topology-only|If set, the app closes automatically after printing the system's topology",
                       [](uint32_t t) { exit(0); });
+  m_parameterList.add("memory-stats|Path of the json file the memory statistics are dumped to", &m_memoryStatisticsPath);
+  m_parameterList.add("page-release-frames|Number of frames a memory page must stay empty before it is released",
+                      &m_pageReleaseFrames);
+  m_parameterList.add("reserved-empty-pages|Number of empty memory pages each memory pool keeps instead of releasing them",
+                      &m_numReservedEmptyPages);
+  m_parameterList.add("queued-frames|Number of frames in flight from 1 to 8, fewer frames reduce the latency, more frames "
+                      "the GPU stalls",
+                      &m_numQueuedFrames);
+  m_parameterList.add("low-latency|If set, the camera and the scene runtime are latched right before each frame is submitted",
+                      [this](uint32_t t) { m_lowLatency = true; });
+  m_parameterList.add("secondary-cmd-buffers|If set, render threads record secondary command buffers which are executed in "
+                      "a single render pass per device",
+                      [this](uint32_t t) { m_useSecondaryCmdBuffers = true; });
+  m_parameterList.add("cache-render-commands|If set, render threads reuse their render commands until they change",
+                      [this](uint32_t t) { m_cacheRenderCommands = true; });
+  m_parameterList.add("async-compute|If set, render threads generate their instances on an async compute queue, if "
+                      "available",
+                      [this](uint32_t t) { m_useAsyncCompute = true; });
+  m_parameterList.add("pipelined-recording|If set, the next frame is recorded while the current one is submitted and the "
+                      "scene is updated",
+                      [this](uint32_t t) { m_pipelinedRecording = true; });
+  m_parameterList.add("cpu-affinity|If set, the recording worker threads are pinned to one CPU each and the render "
+                      "threads record on the NUMA node of their GPU",
+                      [this](uint32_t t) { m_pinWorkerThreads = true; });
   this->queryTolopogy();
   this->setVsync(false);
 }
@@ -139,8 +164,14 @@ bool VkDDisplayApp::begin()
     LOGE("No displays were enabled.\n");
     return false;
   }
+  if(m_pinWorkerThreads)
+  {
+    TaskPool::getShared().pinWorkersToCpus();
+  }
   for(auto const& logicalDevicesIt : m_logicalDevices)
   {
+    logicalDevicesIt.second->setPageReleasePolicy(m_pageReleaseFrames, m_numReservedEmptyPages);
+    logicalDevicesIt.second->setNumQueuedFrames(m_numQueuedFrames);
     if(!logicalDevicesIt.second->start())
     {
       LOGE("Failed to start logical device.");
@@ -165,7 +196,7 @@ bool VkDDisplayApp::enableDisplay(uint32_t globalDisplayIndex, CanvasRegion canv
     // one needs to find the logical device (which represents a Vulkan device group) to which the display is connected and enable it
     DisplayInfo const& dispInfo = m_displayInfos[globalDisplayIndex];
     LogicalDisplay*    logicalDisplay =
-        this->getLogicalDevice(dispInfo.m_deviceGroupIndex)->enableDisplay(m_scene, dispInfo.m_props.display, canvasRegion);
+        this->getLogicalDevice(dispInfo.m_deviceGroupIndex)->enableDisplay(dispInfo.m_props.display, canvasRegion);
     if(logicalDisplay)
     {
       m_possibleSelections.emplace_back(std::make_pair(logicalDisplay, nullptr));
@@ -191,9 +222,27 @@ void VkDDisplayApp::think(double time)
   {
     float frameTimeMillis = 1e3f * (time - lastTime);
     m_scene.update(frameTimeMillis);
+    m_sceneUpdateTime    = std::chrono::steady_clock::now();
+    m_sceneSnapshotIndex = (m_sceneSnapshotIndex + 1) % (uint32_t)m_sceneSnapshots.size();
+    m_scene.takeSnapshot(m_sceneSnapshots[m_sceneSnapshotIndex]);
+    // the scene isn't updated again until the frames are submitted, so the latched runtime is extrapolated
+    GlobalDataLatchFunc latchGlobalData = [this](GlobalData& globalData) {
+      globalData.m_view = m_scene.getCamera().m_view;
+      globalData.m_proj = m_scene.getCamera().m_proj;
+      globalData.m_runtimeMillis =
+          m_scene.getRuntimeMillis()
+          + std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_sceneUpdateTime).count();
+    };
     for(auto& logicalDeviceIt : m_logicalDevices)
     {
-      logicalDeviceIt.second->render();
+      logicalDeviceIt.second->setLowLatencyMode(m_lowLatency ? latchGlobalData : GlobalDataLatchFunc());
+      logicalDeviceIt.second->setDefragmentationEnabled(m_defragmentDeviceMemory);
+      logicalDeviceIt.second->setSecondaryCommandBuffersEnabled(m_useSecondaryCmdBuffers);
+      logicalDeviceIt.second->setRenderCommandCachingEnabled(m_cacheRenderCommands);
+      logicalDeviceIt.second->setAsyncComputeEnabled(m_useAsyncCompute);
+      logicalDeviceIt.second->setNumQueuedFrames(m_numQueuedFrames);
+      logicalDeviceIt.second->setPipelinedRecordingEnabled(m_pipelinedRecording);
+      logicalDeviceIt.second->render(m_sceneSnapshots[m_sceneSnapshotIndex]);
     }
   }
   this->renderGui();
@@ -212,11 +261,27 @@ void VkDDisplayApp::renderGui()
   if(ImGui::Begin("Scene", 0, ImGuiWindowFlags_NoResize))
   {
     ImGui::Checkbox("Pause rendering", &m_paused);
+    ImGui::Checkbox("Defragment device memory", &m_defragmentDeviceMemory);
+    ImGui::Checkbox("Secondary command buffers", &m_useSecondaryCmdBuffers);
+    ImGui::Checkbox("Cache render commands", &m_cacheRenderCommands);
+    ImGui::Checkbox("Generate instances with async compute", &m_useAsyncCompute);
+    uint32_t const minQueuedFrames = 1;
+    ImGui::SliderScalar("Queued frames", ImGuiDataType_U32, &m_numQueuedFrames, &minQueuedFrames, &MAX_QUEUED_FRAMES);
+    ImGui::Checkbox("Low latency (late-latched camera)", &m_lowLatency);
+    ImGui::Checkbox("Pipelined recording", &m_pipelinedRecording);
     ImGui::SliderInt("Number of donuts X", &m_scene.getDesiredNumDonutsX(), 1, 48);
     ImGui::SliderInt("Number of donuts Y", &m_scene.getDesiredNumDonutsY(), 1, 48);
+    for(auto& logicalDeviceIt : m_logicalDevices)
+    {
+      ImGui::Text("Device group %u: GPU %u frames behind", logicalDeviceIt.first, logicalDeviceIt.second->getNumFramesBehind());
+      LatencyStatistics latency = logicalDeviceIt.second->getLatencyStatistics();
+      ImGui::Text("Device group %u: latency %.1f ms (%.2f frames)", logicalDeviceIt.first, latency.m_millis, latency.m_frames);
+    }
     ImGui::End();
   }
 
+  this->renderMemoryStatisticsGui();
+
   int i = 0;
   for(std::pair<LogicalDisplay*, CanvasRegionRenderThread*> s : m_possibleSelections)
   {
@@ -240,6 +305,7 @@ void VkDDisplayApp::renderGui()
         drawList->AddRectFilled(tl, br1, color);
         drawList->AddRectFilled(tl, br2, color);
         ImGui::SliderInt("Fur layers", &s.second->getNumFurLayers(), 1, 128);
+        ImGui::Text("Staging high-water mark: %.1f KiB", (double)s.second->getStagingHighWaterMark() / 1024.0);
 
         ImGui::End();
       }
@@ -252,6 +318,92 @@ void VkDDisplayApp::renderGui()
   ImGui::EndFrame();
 }
 
+void VkDDisplayApp::renderMemoryStatisticsGui()
+{
+  ImGui::SetNextWindowSize(ImGuiH::dpiScaled(480, 0), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowPos(ImGuiH::dpiScaled(520, 20), ImGuiCond_FirstUseEver);
+  if(ImGui::Begin("Memory"))
+  {
+    if(ImGui::Button("Dump statistics"))
+    {
+      this->dumpMemoryStatistics();
+    }
+    for(auto& logicalDeviceIt : m_logicalDevices)
+    {
+      std::stringstream title;
+      title << "Device group " << logicalDeviceIt.first;
+      if(!ImGui::TreeNodeEx(title.str().c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+      {
+        continue;
+      }
+      MemoryStatistics memoryStatistics = logicalDeviceIt.second->getMemoryStatistics();
+      for(MemoryPoolStatistics const& pool : memoryStatistics.m_pools)
+      {
+        VulkanMemoryPool::Statistics const& stats = pool.m_stats;
+        ImGui::Text("%s%s, memory type %u", pool.m_poolName,
+                    pool.m_deviceIndex.has_value() ? (" " + std::to_string(pool.m_deviceIndex.value())).c_str() : "",
+                    pool.m_memTypeIdx);
+        ImGui::Text("  %zu pages, %.2f / %.2f MiB live, largest free block %.2f MiB, %zu free intervals", stats.m_numPages,
+                    (double)stats.m_liveBytes / (1 << 20), (double)stats.m_reservedBytes / (1 << 20),
+                    (double)stats.m_largestFreeBlock / (1 << 20), stats.m_numFreeIntervals);
+        ImGui::Text("  %u allocs, %u frees per frame", stats.m_numAllocs, stats.m_numFrees);
+      }
+      for(MemoryHeapBudget const& heapBudget : memoryStatistics.m_heapBudgets)
+      {
+        ImGui::Text("device %u heap %u: %.2f MiB used, budget %.2f MiB of %.2f MiB", heapBudget.m_deviceIndex,
+                    heapBudget.m_heapIndex, (double)heapBudget.m_usage / (1 << 20),
+                    (double)heapBudget.m_budget / (1 << 20), (double)heapBudget.m_heapSize / (1 << 20));
+      }
+      ImGui::TreePop();
+    }
+  }
+  ImGui::End();
+}
+
+void VkDDisplayApp::dumpMemoryStatistics()
+{
+  nlohmann::json dump = nlohmann::json::array();
+  for(auto& logicalDeviceIt : m_logicalDevices)
+  {
+    MemoryStatistics memoryStatistics = logicalDeviceIt.second->getMemoryStatistics();
+    nlohmann::json   deviceJson       = {{"deviceGroup", logicalDeviceIt.first},
+                                         {"frameIndex", memoryStatistics.m_frameIndex},
+                                         {"pools", nlohmann::json::array()},
+                                         {"heapBudgets", nlohmann::json::array()}};
+    for(MemoryPoolStatistics const& pool : memoryStatistics.m_pools)
+    {
+      nlohmann::json deviceIndex = pool.m_deviceIndex.has_value() ? nlohmann::json(pool.m_deviceIndex.value()) : nlohmann::json();
+      deviceJson["pools"].push_back({{"pool", pool.m_poolName},
+                                     {"deviceIndex", deviceIndex},
+                                     {"memoryTypeIndex", pool.m_memTypeIdx},
+                                     {"numPages", pool.m_stats.m_numPages},
+                                     {"reservedBytes", pool.m_stats.m_reservedBytes},
+                                     {"liveBytes", pool.m_stats.m_liveBytes},
+                                     {"largestFreeBlock", pool.m_stats.m_largestFreeBlock},
+                                     {"numFreeIntervals", pool.m_stats.m_numFreeIntervals},
+                                     {"allocsPerFrame", pool.m_stats.m_numAllocs},
+                                     {"freesPerFrame", pool.m_stats.m_numFrees}});
+    }
+    for(MemoryHeapBudget const& heapBudget : memoryStatistics.m_heapBudgets)
+    {
+      deviceJson["heapBudgets"].push_back({{"deviceIndex", heapBudget.m_deviceIndex},
+                                           {"heapIndex", heapBudget.m_heapIndex},
+                                           {"heapSize", heapBudget.m_heapSize},
+                                           {"budget", heapBudget.m_budget},
+                                           {"usage", heapBudget.m_usage}});
+    }
+    dump.push_back(deviceJson);
+  }
+  std::ofstream file(m_memoryStatisticsPath);
+  if(!file)
+  {
+    LOGE("Failed to write memory statistics to %s.\n", m_memoryStatisticsPath.c_str());
+    return;
+  }
+  file << dump.dump(2) << std::endl;
+  LOGI("Memory statistics written to %s.\n", m_memoryStatisticsPath.c_str());
+}
+
 void VkDDisplayApp::end()
 {
   for(auto& logicalDeviceIt : m_logicalDevices)
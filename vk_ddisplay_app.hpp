@@ -23,6 +23,7 @@
 #include "scene.hpp"
 
 #include <nvgl/appwindowprofiler_gl.hpp>
+#include <chrono>
 #include <unordered_set>
 
 namespace vkdd {
@@ -45,11 +46,27 @@ private:
   };
 
   std::string                                                                    m_configPath;
+  std::string                                                                    m_memoryStatisticsPath = "memory_statistics.json";
   std::vector<DisplayInfo>                                                       m_displayInfos;
   Scene                                                                          m_scene;
+  // the render threads record from a snapshot of the scene, in pipelined mode the snapshot of the previous frame may
+  // still be in use until that frame is submitted
+  std::array<SceneSnapshot, 2>                                                   m_sceneSnapshots;
+  uint32_t                                                                       m_sceneSnapshotIndex     = 0;
   vk::UniqueInstance                                                             m_instance;
   std::unordered_map<uint32_t, std::unique_ptr<class LogicalDevice>>             m_logicalDevices;
-  bool                                                                           m_paused = false;
+  bool                                                                           m_paused                 = false;
+  bool                                                                           m_defragmentDeviceMemory = false;
+  bool                                                                           m_useSecondaryCmdBuffers = false;
+  bool                                                                           m_cacheRenderCommands    = false;
+  bool                                                                           m_useAsyncCompute        = false;
+  bool                                                                           m_lowLatency             = false;
+  bool                                                                           m_pipelinedRecording     = false;
+  bool                                                                           m_pinWorkerThreads       = false;
+  std::chrono::steady_clock::time_point                                          m_sceneUpdateTime;
+  uint32_t                                                                       m_pageReleaseFrames      = 600;
+  uint32_t                                                                       m_numReservedEmptyPages  = 1;
+  uint32_t                                                                       m_numQueuedFrames        = DEFAULT_QUEUED_FRAMES;
   std::vector<std::pair<class LogicalDisplay*, class CanvasRegionRenderThread*>> m_possibleSelections;
   uint32_t                                                                       m_activeSelectionIndex;
 
@@ -58,6 +75,8 @@ private:
   void           visitSelection(std::function<void(CanvasRegionRenderThread*)> visitor);
   void           setActiveSelection(uint32_t activeSelectionIndex);
   void           renderGui();
+  void           renderMemoryStatisticsGui();
+  void           dumpMemoryStatistics();
   void           handleInput();
   bool           enableDisplay(uint32_t globalDisplayIndex, struct CanvasRegion canvasRegion);
   bool           parseDDisplayConfig();
@@ -56,7 +56,9 @@ struct Colors
   inline static Vec3f const BONDI_BLUE = {0.0f, 0.588f, 0.725f};
 };
 
-const uint32_t NUM_QUEUED_FRAMES = 4;
+// the number of queued frames is a runtime setting of each logical device, up to MAX_QUEUED_FRAMES
+const uint32_t MAX_QUEUED_FRAMES     = 8;
+const uint32_t DEFAULT_QUEUED_FRAMES = 4;
 
 typedef uint64_t                   FrameIndex;
 typedef uint32_t                   DeviceIndex;
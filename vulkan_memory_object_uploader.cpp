@@ -25,7 +25,7 @@
 namespace vkdd {
 struct BufferCopy
 {
-  BufferAllocation        m_srcBufferAllocation;
+  vk::Buffer              m_srcBuffer;
   vk::Buffer              m_dstBuffer;
   vk::BufferCopy          m_region;
   vk::PipelineStageFlags2 m_dstStageMask;
@@ -46,12 +46,11 @@ void VulkanMemoryObjectUploader::memcpyHost2Buffer(vk::Buffer              dstBu
                                                    size_t                  size,
                                                    vk::PipelineStageFlags2 dstStageMask)
 {
+  StagingBufferRange staging = m_logicalDevice.allocateFrameStagingMemory(size);
+  memcpy(staging.m_mapped, srcData, size);
   std::lock_guard guard(m_mutex);
-  vk::BufferCreateInfo stagingBufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive);
-  BufferAllocation stagingBufferAllocation = m_logicalDevice.allocateStagingBuffer(stagingBufferCreateInfo);
-  memcpy(stagingBufferAllocation.m_allocation.mappedMem(), srcData, size);
   m_bufferCopies.emplace_back(
-      BufferCopy{std::move(stagingBufferAllocation), dstBuffer, vk::BufferCopy{0, dstBufferOffset, size}, dstStageMask});
+      BufferCopy{staging.m_buffer, dstBuffer, vk::BufferCopy{staging.m_offset, dstBufferOffset, size}, dstStageMask});
 }
 
 void VulkanMemoryObjectUploader::prepare(class CommandExecutionUnit& cmdExecUnit)
@@ -74,16 +73,20 @@ void VulkanMemoryObjectUploader::finish()
   {
     releases.emplace_back(vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eMemoryWrite, vk::PipelineStageFlagBits2::eNone,
                           vk::AccessFlagBits2::eNone, m_logicalDevice.getTransferQueueFamilyIndex(),
-                          m_logicalDevice.getGraphicsQueueFamilyIndex(), bufferCopy.m_dstBuffer, 0, bufferCopy.m_region.size);
+                          m_logicalDevice.getGraphicsQueueFamilyIndex(), bufferCopy.m_dstBuffer,
+                          bufferCopy.m_region.dstOffset, bufferCopy.m_region.size);
     acquisitions.emplace_back(vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, bufferCopy.m_dstStageMask,
-                              vk::AccessFlagBits2::eMemoryRead, m_logicalDevice.getGraphicsQueueFamilyIndex(),
-                              m_logicalDevice.getTransferQueueFamilyIndex(), bufferCopy.m_dstBuffer, 0,
-                              bufferCopy.m_region.size);
+                              vk::AccessFlagBits2::eMemoryRead, m_logicalDevice.getTransferQueueFamilyIndex(),
+                              m_logicalDevice.getGraphicsQueueFamilyIndex(), bufferCopy.m_dstBuffer,
+                              bufferCopy.m_region.dstOffset, bufferCopy.m_region.size);
   }
-  for(BufferCopy& bufferCopy : m_bufferCopies)
+  // the destinations may be ranges of shared buffers, so the barriers only cover the copied ranges
+  for(BufferCopy const& bufferCopy : m_bufferCopies)
+  {
+    m_transferCmdBuffer.copyBuffer(bufferCopy.m_srcBuffer, bufferCopy.m_dstBuffer, bufferCopy.m_region);
+  }
+  if(!m_bufferCopies.empty())
   {
-    m_transferCmdBuffer.copyBuffer(bufferCopy.m_srcBufferAllocation.m_buffer.get(), bufferCopy.m_dstBuffer, bufferCopy.m_region);
-    m_logicalDevice.scheduleForDeallocation(std::move(bufferCopy.m_srcBufferAllocation));
     m_transferCmdBuffer.pipelineBarrier2({vk::DependencyFlagBits::eByRegion, {}, releases});
     m_graphicsCmdBuffer.pipelineBarrier2({vk::DependencyFlagBits::eByRegion, {}, acquisitions});
   }
@@ -19,49 +19,84 @@
 
 #include "vulkan_memory_pool.hpp"
 
+#include "free_interval_list.hpp"
+
 namespace vkdd {
-struct Interval
+// allocates the pages from a Vulkan device
+class DevicePageBackend : public VulkanMemoryPool::PageBackend
 {
-  size_t m_begin;
-  size_t m_end;
-
-  bool operator<(Interval const& right) const;
-  bool intersects(Interval const& other) const;
-};
+public:
+  DevicePageBackend(vk::Device device)
+      : m_device(device)
+  {
+  }
 
-bool Interval::operator<(Interval const& right) const
-{
-  return m_begin != right.m_begin ? m_begin < right.m_begin : m_end < right.m_end;
-}
+  vk::DeviceMemory allocate(vk::MemoryAllocateInfo const& allocateInfo) override
+  {
+    return m_device.allocateMemory(allocateInfo);
+  }
+  void  free(vk::DeviceMemory devMem) override { m_device.freeMemory(devMem); }
+  void* map(vk::DeviceMemory devMem, size_t size) override { return m_device.mapMemory(devMem, 0, size); }
+  void  unmap(vk::DeviceMemory devMem) override { m_device.unmapMemory(devMem); }
 
-bool Interval::intersects(Interval const& other) const
-{
-  return m_begin < other.m_end && other.m_begin < m_end;
-}
+private:
+  vk::Device m_device;
+};
 
 struct PageAllocation
 {
-  vk::Device             m_device;
-  vk::UniqueDeviceMemory m_devMem;
-  void*                  m_mapped;
-  size_t                 m_size;
-  std::vector<Interval>  m_freeIntervals;
+  VulkanMemoryPool::PageBackend* m_backend;
+  vk::DeviceMemory               m_devMem;
+  void*                          m_mapped;
+  size_t                         m_size;
+  size_t                         m_liveBytes;
+  size_t                         m_pageIndex;
+  uint32_t                       m_numEmptyFrames;
+  bool                           m_dedicated;
+  bool                           m_evacuating;
+  bool                           m_pinned;
+  FreeIntervalList               m_freeIntervals;
 
   PageAllocation(PageAllocation&& other);
-  PageAllocation(vk::Device device, vk::UniqueDeviceMemory&& devMem, size_t size);
+  PageAllocation(VulkanMemoryPool::PageBackend* backend, vk::DeviceMemory devMem, size_t size);
   ~PageAllocation();
 
   std::optional<Interval> requestInterval(size_t size, size_t alignment);
   void                    returnInterval(Interval interval);
 };
 
+// a slab is a single interval of a page that is split into equally sized blocks
+// its free blocks are kept on a stack, so that requesting and returning a block is constant time
+struct Slab
+{
+  PageAllocation*       m_page;
+  void*                 m_mapped;
+  Interval              m_interval;
+  uint32_t              m_sizeClass;
+  size_t                m_blockSize;
+  uint32_t              m_numBlocks;
+  std::vector<uint32_t> m_freeBlocks;
+  size_t                m_slabIndex;
+  size_t                m_partialSlabIndex;
+};
+
+struct SizeClassBin
+{
+  std::vector<std::unique_ptr<Slab>> m_slabs;
+  std::vector<Slab*>                 m_partialSlabs;
+};
+
+static size_t const NO_PARTIAL_SLAB_INDEX = (size_t)-1;
+
 VulkanMemoryPool::Allocation::Allocation()
-    : Allocation(nullptr, nullptr, 0, nullptr, 0)
+    : Allocation(nullptr, nullptr, nullptr, nullptr, 0, nullptr, 0)
 {
 }
 
 VulkanMemoryPool::Allocation::Allocation(Allocation&& other)
     : m_memPool(other.m_memPool)
+    , m_page(other.m_page)
+    , m_slab(other.m_slab)
     , m_devMem(other.m_devMem)
     , m_devMemOffset(other.m_devMemOffset)
     , m_mappedMem(other.m_mappedMem)
@@ -70,8 +105,16 @@ VulkanMemoryPool::Allocation::Allocation(Allocation&& other)
   other.clear();
 }
 
-VulkanMemoryPool::Allocation::Allocation(VulkanMemoryPool* memPool, vk::DeviceMemory devMem, size_t devMemOffset, void* mappedMem, size_t size)
+VulkanMemoryPool::Allocation::Allocation(VulkanMemoryPool* memPool,
+                                         PageAllocation*   page,
+                                         Slab*             slab,
+                                         vk::DeviceMemory  devMem,
+                                         size_t            devMemOffset,
+                                         void*             mappedMem,
+                                         size_t            size)
     : m_memPool(memPool)
+    , m_page(page)
+    , m_slab(slab)
     , m_devMem(devMem)
     , m_devMemOffset(devMemOffset)
     , m_mappedMem(mappedMem)
@@ -90,6 +133,8 @@ VulkanMemoryPool::Allocation& VulkanMemoryPool::Allocation::operator=(Allocation
   {
     this->free();
     m_memPool      = other.m_memPool;
+    m_page         = other.m_page;
+    m_slab         = other.m_slab;
     m_devMem       = other.m_devMem;
     m_devMemOffset = other.m_devMemOffset;
     m_mappedMem    = other.m_mappedMem;
@@ -102,12 +147,19 @@ VulkanMemoryPool::Allocation& VulkanMemoryPool::Allocation::operator=(Allocation
 void VulkanMemoryPool::Allocation::clear()
 {
   m_memPool      = nullptr;
+  m_page         = nullptr;
+  m_slab         = nullptr;
   m_devMem       = nullptr;
   m_devMemOffset = 0;
   m_mappedMem    = nullptr;
   m_size         = 0;
 }
 
+bool VulkanMemoryPool::Allocation::isEvacuating() const
+{
+  return m_page && m_page->m_evacuating;
+}
+
 void VulkanMemoryPool::Allocation::free()
 {
   if(m_memPool)
@@ -118,163 +170,477 @@ void VulkanMemoryPool::Allocation::free()
 }
 
 PageAllocation::PageAllocation(PageAllocation&& other)
-    : m_device(other.m_device)
-    , m_devMem(std::move(other.m_devMem))
+    : m_backend(other.m_backend)
+    , m_devMem(other.m_devMem)
     , m_mapped(other.m_mapped)
     , m_size(other.m_size)
+    , m_liveBytes(other.m_liveBytes)
+    , m_pageIndex(other.m_pageIndex)
+    , m_numEmptyFrames(other.m_numEmptyFrames)
+    , m_dedicated(other.m_dedicated)
+    , m_evacuating(other.m_evacuating)
+    , m_pinned(other.m_pinned)
     , m_freeIntervals(std::move(other.m_freeIntervals))
 {
-  other.m_device = nullptr;
-  other.m_mapped = nullptr;
-  other.m_size   = 0;
+  other.m_backend   = nullptr;
+  other.m_devMem    = nullptr;
+  other.m_mapped    = nullptr;
+  other.m_size      = 0;
+  other.m_liveBytes = 0;
 }
 
-PageAllocation::PageAllocation(vk::Device device, vk::UniqueDeviceMemory&& devMem, size_t size)
-    : m_device(device)
-    , m_devMem(std::move(devMem))
+PageAllocation::PageAllocation(VulkanMemoryPool::PageBackend* backend, vk::DeviceMemory devMem, size_t size)
+    : m_backend(backend)
+    , m_devMem(devMem)
     , m_mapped(nullptr)
     , m_size(size)
-    , m_freeIntervals{{0, m_size}}
+    , m_liveBytes(0)
+    , m_pageIndex(0)
+    , m_numEmptyFrames(0)
+    , m_dedicated(false)
+    , m_evacuating(false)
+    , m_pinned(false)
+    , m_freeIntervals(size)
 {
 }
 
 PageAllocation::~PageAllocation()
 {
-  assert(m_size == 0
-         || (m_freeIntervals.size() == 1 && m_freeIntervals.front().m_begin == 0 && m_freeIntervals.front().m_end == m_size));
-  if(m_devMem && m_mapped)
+  assert(m_size == 0 || m_freeIntervals.isUnused());
+  if(m_devMem)
   {
-    m_device.unmapMemory(m_devMem.get());
+    if(m_mapped)
+    {
+      m_backend->unmap(m_devMem);
+    }
+    m_backend->free(m_devMem);
   }
 }
 
-VulkanMemoryPool::VulkanMemoryPool(vk::Device device, DeviceMask deviceMask, MemTypeIndex memTypeIdx, bool keepMapped, size_t minPageAllocationSize)
-    : m_device(device)
+VulkanMemoryPool::VulkanMemoryPool(vk::Device   device,
+                                   DeviceMask   deviceMask,
+                                   MemTypeIndex memTypeIdx,
+                                   bool         keepMapped,
+                                   size_t       minPageAllocationSize,
+                                   SlabPolicy   slabPolicy,
+                                   PageBackend* pageBackend)
+    : m_devicePageBackend(pageBackend ? nullptr : std::make_unique<DevicePageBackend>(device))
+    , m_pageBackend(pageBackend ? pageBackend : m_devicePageBackend.get())
     , m_deviceMask(deviceMask)
     , m_memTypeIdx(memTypeIdx)
     , m_keepMapped(keepMapped)
     , m_minPageAllocationSize(minPageAllocationSize)
+    , m_slabPolicy(slabPolicy)
+    , m_sizeClassBins(NUM_SIZE_CLASSES)
+    , m_evacuatingPage(nullptr)
+    , m_numAllocs(0)
+    , m_numFrees(0)
 {
 }
 
-VulkanMemoryPool::~VulkanMemoryPool() {}
+VulkanMemoryPool::~VulkanMemoryPool()
+{
+  // all slabs must be returned to their pages before the pages get destroyed
+  for(SizeClassBin& bin : m_sizeClassBins)
+  {
+    while(!bin.m_slabs.empty())
+    {
+      this->destroySlab(bin.m_slabs.back().get());
+    }
+  }
+}
 
-VulkanMemoryPool::Allocation VulkanMemoryPool::alloc(size_t size, size_t alignment)
+std::optional<uint32_t> VulkanMemoryPool::getSizeClass(size_t size, size_t alignment) const
 {
-  std::lock_guard guard(m_mtx);
-  for(PageAllocation& pageAllocation : m_pageAllocations)
+  // memory alignments are powers of two and each block is aligned to its own size, therefore a block satisfies any
+  // alignment up to its size
+  if(m_slabPolicy == SlabPolicy::NO_SLABS)
+  {
+    return {};
+  }
+  size_t   blockSize     = std::max(size, alignment);
+  uint32_t sizeClassLog2 = MIN_SIZE_CLASS_LOG2;
+  while(((size_t)1 << sizeClassLog2) < blockSize)
+  {
+    ++sizeClassLog2;
+  }
+  if(MAX_SIZE_CLASS_LOG2 < sizeClassLog2)
+  {
+    return {};
+  }
+  return sizeClassLog2 - MIN_SIZE_CLASS_LOG2;
+}
+
+PageAllocation& VulkanMemoryPool::requestPageInterval(size_t size, size_t alignment, Interval& interval)
+{
+  for(std::unique_ptr<PageAllocation> const& pageAllocation : m_pageAllocations)
   {
-    std::optional<Interval> interval = pageAllocation.requestInterval(size, alignment);
-    if(interval.has_value())
+    if(pageAllocation->m_evacuating || pageAllocation->m_dedicated)
+    {
+      continue;
+    }
+    std::optional<Interval> requestedInterval = pageAllocation->requestInterval(size, alignment);
+    if(requestedInterval.has_value())
     {
-      return {this, pageAllocation.m_devMem.get(), interval.value().m_begin,
-              m_keepMapped ? (char*)pageAllocation.m_mapped + interval.value().m_begin : nullptr,
-              interval.value().m_end - interval.value().m_begin};
+      interval = requestedInterval.value();
+      return *pageAllocation;
     }
   }
-  size_t                      pageSize = std::max(size, m_minPageAllocationSize);
-  vk::MemoryAllocateInfo      allocateInfo(pageSize, m_memTypeIdx);
+  PageAllocation& page = this->createPage(std::max(size, m_minPageAllocationSize), nullptr);
+  interval             = page.requestInterval(size, alignment).value();
+  return page;
+}
+
+PageAllocation& VulkanMemoryPool::createPage(size_t size, vk::MemoryDedicatedAllocateInfo const* dedicatedAllocateInfo)
+{
+  vk::MemoryAllocateInfo      allocateInfo(size, m_memTypeIdx);
   vk::MemoryAllocateFlagsInfo allocateFlagsInfo(vk::MemoryAllocateFlagBits::eDeviceMask, m_deviceMask);
   if(m_deviceMask != 0)
   {
+    allocateFlagsInfo.setPNext(dedicatedAllocateInfo);
     allocateInfo.setPNext(&allocateFlagsInfo);
   }
-  m_pageAllocations.emplace_back(m_device, m_device.allocateMemoryUnique(allocateInfo), pageSize);
+  else
+  {
+    allocateInfo.setPNext(dedicatedAllocateInfo);
+  }
+  PageAllocation& page = *m_pageAllocations.emplace_back(
+      std::make_unique<PageAllocation>(m_pageBackend, m_pageBackend->allocate(allocateInfo), size));
+  page.m_pageIndex = m_pageAllocations.size() - 1;
+  page.m_dedicated = dedicatedAllocateInfo != nullptr;
   std::array<char const*, 4> units = {"", "Ki", "Mi", "Gi"};
-  uint32_t unitIdx      = (uint32_t)std::min((size_t)std::floor(std::log2((double)pageSize) / 10.0f), units.size() - 1);
-  float    displayValue = (double)pageSize / (double)(std::size_t(1) << (10 * unitIdx));
-  LOGI("New %s memory allocation: %.2f %sB.\n", m_keepMapped ? "system" : "device", displayValue, units[unitIdx]);
+  uint32_t unitIdx      = (uint32_t)std::min((size_t)std::floor(std::log2((double)size) / 10.0f), units.size() - 1);
+  float    displayValue = (double)size / (double)(std::size_t(1) << (10 * unitIdx));
+  LOGI("New %s%s memory allocation: %.2f %sB.\n", page.m_dedicated ? "dedicated " : "", m_keepMapped ? "system" : "device",
+       displayValue, units[unitIdx]);
   if(m_keepMapped)
   {
-    m_pageAllocations.back().m_mapped = m_device.mapMemory(m_pageAllocations.back().m_devMem.get(), 0, pageSize);
+    page.m_mapped = m_pageBackend->map(page.m_devMem, size);
   }
-  vk::DeviceMemory devMem   = m_pageAllocations.back().m_devMem.get();
-  Interval         interval = m_pageAllocations.back().requestInterval(size, alignment).value();
-  return {this, devMem, interval.m_begin, m_keepMapped ? (char*)m_pageAllocations.back().m_mapped + interval.m_begin : nullptr,
-          interval.m_end - interval.m_begin};
+  return page;
 }
 
-void VulkanMemoryPool::free(Allocation const& allocation)
+Slab* VulkanMemoryPool::createSlab(uint32_t sizeClass)
 {
-  std::lock_guard guard(m_mtx);
-  auto            findIt = std::find_if(m_pageAllocations.begin(), m_pageAllocations.end(),
-                                        [&](PageAllocation const& pa) { return pa.m_devMem.get() == allocation.m_devMem; });
-  assert(findIt != m_pageAllocations.end());
-  findIt->returnInterval({allocation.m_devMemOffset, allocation.m_devMemOffset + allocation.m_size});
+  SizeClassBin&         bin       = m_sizeClassBins[sizeClass];
+  size_t                blockSize = (size_t)1 << (MIN_SIZE_CLASS_LOG2 + sizeClass);
+  size_t                slabSize  = std::max(MIN_SLAB_SIZE, MIN_BLOCKS_PER_SLAB * blockSize);
+  std::unique_ptr<Slab> slab      = std::make_unique<Slab>();
+  PageAllocation&       page      = this->requestPageInterval(slabSize, blockSize, slab->m_interval);
+  slab->m_page                    = &page;
+  slab->m_mapped                  = m_keepMapped ? (char*)page.m_mapped + slab->m_interval.m_begin : nullptr;
+  slab->m_sizeClass               = sizeClass;
+  slab->m_blockSize               = blockSize;
+  slab->m_numBlocks               = (uint32_t)(slabSize / blockSize);
+  slab->m_freeBlocks.resize(slab->m_numBlocks);
+  for(uint32_t i = 0; i < slab->m_numBlocks; ++i)
+  {
+    // lower blocks are handed out first
+    slab->m_freeBlocks[i] = slab->m_numBlocks - 1 - i;
+  }
+  slab->m_slabIndex        = bin.m_slabs.size();
+  slab->m_partialSlabIndex = bin.m_partialSlabs.size();
+  bin.m_partialSlabs.emplace_back(slab.get());
+  return bin.m_slabs.emplace_back(std::move(slab)).get();
 }
 
-std::optional<Interval> PageAllocation::requestInterval(size_t size, size_t alignment)
+void VulkanMemoryPool::destroySlab(Slab* slab)
+{
+  assert(slab->m_freeBlocks.size() == slab->m_numBlocks);
+  SizeClassBin& bin = m_sizeClassBins[slab->m_sizeClass];
+  this->removePartialSlab(slab);
+  slab->m_page->returnInterval(slab->m_interval);
+  size_t slabIndex                    = slab->m_slabIndex;
+  bin.m_slabs[slabIndex]              = std::move(bin.m_slabs.back());
+  bin.m_slabs[slabIndex]->m_slabIndex = slabIndex;
+  bin.m_slabs.pop_back();
+}
+
+void VulkanMemoryPool::removePartialSlab(Slab* slab)
 {
-  for(auto it = m_freeIntervals.begin(); it != m_freeIntervals.end(); ++it)
+  if(slab->m_partialSlabIndex != NO_PARTIAL_SLAB_INDEX)
   {
-    Interval& interval     = *it;
-    size_t    alignedBegin = interval.m_begin + (alignment - interval.m_begin % alignment) % alignment;
-    if(alignedBegin + size <= interval.m_end)
+    SizeClassBin& bin                                                = m_sizeClassBins[slab->m_sizeClass];
+    bin.m_partialSlabs[slab->m_partialSlabIndex]                     = bin.m_partialSlabs.back();
+    bin.m_partialSlabs[slab->m_partialSlabIndex]->m_partialSlabIndex = slab->m_partialSlabIndex;
+    bin.m_partialSlabs.pop_back();
+    slab->m_partialSlabIndex = NO_PARTIAL_SLAB_INDEX;
+  }
+}
+
+void VulkanMemoryPool::releasePage(PageAllocation* page)
+{
+  assert(page->m_liveBytes == 0);
+  if(m_evacuatingPage == page)
+  {
+    m_evacuatingPage = nullptr;
+  }
+  LOGI("Released %s memory page of %zu bytes.\n", m_keepMapped ? "system" : "device", page->m_size);
+  size_t pageIndex                          = page->m_pageIndex;
+  m_pageAllocations[pageIndex]              = std::move(m_pageAllocations.back());
+  m_pageAllocations[pageIndex]->m_pageIndex = pageIndex;
+  m_pageAllocations.pop_back();
+}
+
+bool VulkanMemoryPool::beginEvacuation(float maxPageOccupancy)
+{
+  std::lock_guard guard(m_mtx);
+  if(m_evacuatingPage)
+  {
+    return true;
+  }
+  size_t totalFreeBytes = 0;
+  for(std::unique_ptr<PageAllocation> const& page : m_pageAllocations)
+  {
+    totalFreeBytes += page->m_size - page->m_liveBytes;
+  }
+  PageAllocation* sparsestPage = nullptr;
+  for(std::unique_ptr<PageAllocation> const& page : m_pageAllocations)
+  {
+    // the live bytes of the evacuated page must fit into the free space of the remaining pages
+    bool sparse        = (float)page->m_liveBytes < maxPageOccupancy * (float)page->m_size;
+    bool fitsElsewhere = page->m_liveBytes <= totalFreeBytes - (page->m_size - page->m_liveBytes);
+    if(!page->m_pinned && !page->m_dedicated && sparse && fitsElsewhere
+       && (!sparsestPage || page->m_liveBytes * sparsestPage->m_size < sparsestPage->m_liveBytes * page->m_size))
     {
-      if(alignedBegin == interval.m_begin && alignedBegin + size == interval.m_end)
-      {
-        m_freeIntervals.erase(it);
-      }
-      else if(alignedBegin + size == interval.m_end)
+      sparsestPage = page.get();
+    }
+  }
+  if(!sparsestPage)
+  {
+    return false;
+  }
+  sparsestPage->m_evacuating = true;
+  m_evacuatingPage           = sparsestPage;
+  // slabs of the evacuated page must not hand out any more blocks and empty ones can be returned right away
+  for(SizeClassBin& bin : m_sizeClassBins)
+  {
+    for(size_t i = bin.m_slabs.size(); 0 < i; --i)
+    {
+      Slab* slab = bin.m_slabs[i - 1].get();
+      if(slab->m_page == sparsestPage)
       {
-        interval.m_end = alignedBegin;
+        this->removePartialSlab(slab);
+        if(slab->m_freeBlocks.size() == slab->m_numBlocks)
+        {
+          this->destroySlab(slab);
+        }
       }
-      else
+    }
+  }
+  if(sparsestPage->m_liveBytes == 0)
+  {
+    this->releasePage(sparsestPage);
+  }
+  return true;
+}
+
+void VulkanMemoryPool::endEvacuation()
+{
+  std::lock_guard guard(m_mtx);
+  if(m_evacuatingPage)
+  {
+    m_evacuatingPage->m_evacuating = false;
+    m_evacuatingPage->m_pinned     = true;
+    for(SizeClassBin& bin : m_sizeClassBins)
+    {
+      for(std::unique_ptr<Slab> const& slab : bin.m_slabs)
       {
-        size_t prevIntervalBegin = interval.m_begin;
-        interval.m_begin         = alignedBegin + size;
-        if(prevIntervalBegin != alignedBegin)
+        if(slab->m_page == m_evacuatingPage && !slab->m_freeBlocks.empty()
+           && slab->m_partialSlabIndex == NO_PARTIAL_SLAB_INDEX)
         {
-          m_freeIntervals.insert(it, {prevIntervalBegin, alignedBegin});
+          slab->m_partialSlabIndex = bin.m_partialSlabs.size();
+          bin.m_partialSlabs.emplace_back(slab.get());
         }
       }
-      return {{alignedBegin, alignedBegin + size}};
     }
+    m_evacuatingPage = nullptr;
   }
-  return {};
 }
 
-void PageAllocation::returnInterval(Interval interval)
+bool VulkanMemoryPool::isEvacuating()
+{
+  std::lock_guard guard(m_mtx);
+  return m_evacuatingPage != nullptr;
+}
+
+void VulkanMemoryPool::releaseEmptyPages(uint32_t minEmptyFrames, uint32_t numReservedPages)
 {
-  if(interval.m_begin == interval.m_end)
+  std::lock_guard guard(m_mtx);
+  // the blocks of empty slabs are not in use, so a page whose live bytes all belong to empty slabs is empty as well
+  std::vector<size_t> emptySlabBytes(m_pageAllocations.size(), 0);
+  for(SizeClassBin const& bin : m_sizeClassBins)
   {
-    return;
+    for(Slab const* slab : bin.m_partialSlabs)
+    {
+      if(slab->m_freeBlocks.size() == slab->m_numBlocks)
+      {
+        emptySlabBytes[slab->m_page->m_pageIndex] += slab->m_interval.m_end - slab->m_interval.m_begin;
+      }
+    }
   }
-  auto lbIt = std::lower_bound(m_freeIntervals.begin(), m_freeIntervals.end(), interval);
-  if(lbIt == m_freeIntervals.end())
+  uint32_t numEmptyPages = 0;
+  for(std::unique_ptr<PageAllocation> const& page : m_pageAllocations)
   {
-    if(!m_freeIntervals.empty() && m_freeIntervals.back().m_end == lbIt->m_begin)
+    if(page->m_liveBytes == emptySlabBytes[page->m_pageIndex])
     {
-      m_freeIntervals.back().m_end = lbIt->m_end;
+      ++page->m_numEmptyFrames;
+      ++numEmptyPages;
     }
     else
     {
-      m_freeIntervals.emplace_back(interval);
+      page->m_numEmptyFrames = 0;
     }
   }
-  else
+  // releasing a page moves the last page into its slot, so the pages are visited back to front
+  for(size_t i = m_pageAllocations.size(); 0 < i && numReservedPages < numEmptyPages; --i)
   {
-    assert(lbIt == m_freeIntervals.begin() || !(lbIt - 1)->intersects(interval));
-    assert(!lbIt->intersects(interval));
-    bool mergeWithPrev = lbIt != m_freeIntervals.begin() && (lbIt - 1)->m_end == interval.m_begin;
-    bool mergeWithNext = interval.m_end == lbIt->m_begin;
-    if(mergeWithPrev && mergeWithNext)
+    PageAllocation* page = m_pageAllocations[i - 1].get();
+    if(page->m_numEmptyFrames == 0 || page->m_numEmptyFrames < minEmptyFrames)
     {
-      (lbIt - 1)->m_end = lbIt->m_end;
-      m_freeIntervals.erase(lbIt);
+      continue;
     }
-    else if(mergeWithPrev)
+    for(SizeClassBin& bin : m_sizeClassBins)
     {
-      (lbIt - 1)->m_end = interval.m_end;
+      for(size_t j = bin.m_slabs.size(); 0 < j; --j)
+      {
+        if(bin.m_slabs[j - 1]->m_page == page)
+        {
+          this->destroySlab(bin.m_slabs[j - 1].get());
+        }
+      }
     }
-    else if(mergeWithNext)
+    this->releasePage(page);
+    --numEmptyPages;
+  }
+}
+
+VulkanMemoryPool::Allocation VulkanMemoryPool::allocDedicated(size_t size, vk::MemoryDedicatedAllocateInfo const& dedicatedAllocateInfo)
+{
+  std::lock_guard guard(m_mtx);
+  ++m_numAllocs;
+  PageAllocation& page     = this->createPage(size, &dedicatedAllocateInfo);
+  Interval        interval = page.requestInterval(size, 1).value();
+  return {this, &page, nullptr, page.m_devMem, interval.m_begin, page.m_mapped, size};
+}
+
+VulkanMemoryPool::Statistics VulkanMemoryPool::collectStatistics()
+{
+  std::lock_guard guard(m_mtx);
+  Statistics      stats = {m_pageAllocations.size(), 0, 0, 0, 0, m_numAllocs, m_numFrees};
+  for(std::unique_ptr<PageAllocation> const& page : m_pageAllocations)
+  {
+    stats.m_reservedBytes += page->m_size;
+    stats.m_liveBytes += page->m_liveBytes;
+    stats.m_numFreeIntervals += page->m_freeIntervals.getIntervals().size();
+    for(Interval const& interval : page->m_freeIntervals.getIntervals())
     {
-      lbIt->m_begin = interval.m_begin;
+      stats.m_largestFreeBlock = std::max(stats.m_largestFreeBlock, interval.m_end - interval.m_begin);
     }
-    else
+  }
+  for(SizeClassBin const& bin : m_sizeClassBins)
+  {
+    for(std::unique_ptr<Slab> const& slab : bin.m_slabs)
     {
-      m_freeIntervals.insert(lbIt, interval);
+      stats.m_liveBytes -= slab->m_freeBlocks.size() * slab->m_blockSize;
     }
   }
+  m_numAllocs = 0;
+  m_numFrees  = 0;
+  return stats;
+}
+
+VulkanMemoryPool::Allocation VulkanMemoryPool::alloc(size_t size, size_t alignment)
+{
+  std::lock_guard         guard(m_mtx);
+  ++m_numAllocs;
+  std::optional<uint32_t> sizeClass = this->getSizeClass(size, alignment);
+  if(sizeClass.has_value())
+  {
+    SizeClassBin& bin  = m_sizeClassBins[sizeClass.value()];
+    Slab*         slab = bin.m_partialSlabs.empty() ? this->createSlab(sizeClass.value()) : bin.m_partialSlabs.back();
+    uint32_t      blockIdx = slab->m_freeBlocks.back();
+    slab->m_freeBlocks.pop_back();
+    if(slab->m_freeBlocks.empty())
+    {
+      // the slab is always the last partial slab of its bin
+      bin.m_partialSlabs.pop_back();
+      slab->m_partialSlabIndex = NO_PARTIAL_SLAB_INDEX;
+    }
+    size_t blockOffset = blockIdx * slab->m_blockSize;
+    return {this,
+            slab->m_page,
+            slab,
+            slab->m_page->m_devMem,
+            slab->m_interval.m_begin + blockOffset,
+            m_keepMapped ? (char*)slab->m_mapped + blockOffset : nullptr,
+            slab->m_blockSize};
+  }
+  Interval        interval;
+  PageAllocation& page = this->requestPageInterval(size, alignment, interval);
+  return {this, &page, nullptr, page.m_devMem, interval.m_begin,
+          m_keepMapped ? (char*)page.m_mapped + interval.m_begin : nullptr, interval.m_end - interval.m_begin};
+}
+
+void VulkanMemoryPool::free(Allocation const& allocation)
+{
+  std::lock_guard guard(m_mtx);
+  ++m_numFrees;
+  if(allocation.m_slab)
+  {
+    Slab*         slab = allocation.m_slab;
+    SizeClassBin& bin  = m_sizeClassBins[slab->m_sizeClass];
+    slab->m_freeBlocks.emplace_back((uint32_t)((allocation.m_devMemOffset - slab->m_interval.m_begin) / slab->m_blockSize));
+    if(slab->m_page->m_evacuating)
+    {
+      if(slab->m_freeBlocks.size() == slab->m_numBlocks)
+      {
+        PageAllocation* page = slab->m_page;
+        this->destroySlab(slab);
+        if(page->m_liveBytes == 0)
+        {
+          this->releasePage(page);
+        }
+      }
+      return;
+    }
+    if(slab->m_partialSlabIndex == NO_PARTIAL_SLAB_INDEX)
+    {
+      slab->m_partialSlabIndex = bin.m_partialSlabs.size();
+      bin.m_partialSlabs.emplace_back(slab);
+    }
+    // an empty slab is returned to its page unless it is the only one left in its bin, which avoids creating and
+    // destroying the same slab over and over again
+    if(slab->m_freeBlocks.size() == slab->m_numBlocks
+       && (m_slabPolicy == SlabPolicy::RELEASE_EMPTY_SLABS || 1 < bin.m_partialSlabs.size()))
+    {
+      this->destroySlab(slab);
+    }
+    return;
+  }
+  allocation.m_page->returnInterval({allocation.m_devMemOffset, allocation.m_devMemOffset + allocation.m_size});
+  if((allocation.m_page->m_evacuating || allocation.m_page->m_dedicated) && allocation.m_page->m_liveBytes == 0)
+  {
+    this->releasePage(allocation.m_page);
+  }
+}
+
+std::optional<Interval> PageAllocation::requestInterval(size_t size, size_t alignment)
+{
+  std::optional<Interval> interval = m_freeIntervals.requestInterval(size, alignment);
+  if(interval.has_value())
+  {
+    m_liveBytes += size;
+  }
+  return interval;
+}
+
+void PageAllocation::returnInterval(Interval interval)
+{
+  if(interval.m_begin != interval.m_end)
+  {
+    m_liveBytes -= interval.m_end - interval.m_begin;
+    m_freeIntervals.returnInterval(interval);
+  }
 }
 }  // namespace vkdd
@@ -28,21 +28,104 @@ class VulkanMemoryPool
 public:
   class Allocation;
 
-  VulkanMemoryPool(vk::Device device, DeviceMask deviceMask, MemTypeIndex memTypeIdx, bool keepMapped, size_t minPageAllocationSize = 4 << 20);
+  // the memory of the pages is allocated through a page backend, by default from the pool's device
+  // the memory pool benchmark replaces it with host memory to replay allocation traces without a device
+  class PageBackend
+  {
+  public:
+    virtual ~PageBackend() {}
+
+    virtual vk::DeviceMemory allocate(vk::MemoryAllocateInfo const& allocateInfo) = 0;
+    virtual void             free(vk::DeviceMemory devMem)                        = 0;
+    virtual void*            map(vk::DeviceMemory devMem, size_t size)            = 0;
+    virtual void             unmap(vk::DeviceMemory devMem)                       = 0;
+  };
+
+  struct Statistics
+  {
+    size_t   m_numPages;
+    size_t   m_reservedBytes;
+    size_t   m_liveBytes;
+    size_t   m_largestFreeBlock;
+    size_t   m_numFreeIntervals;
+    uint32_t m_numAllocs;
+    uint32_t m_numFrees;
+  };
+
+  // how small and medium sized allocations are served, the app always keeps the last empty slab of a bin, the other
+  // policies only exist to compare against in the memory pool benchmark
+  enum class SlabPolicy
+  {
+    NO_SLABS,
+    RELEASE_EMPTY_SLABS,
+    KEEP_LAST_EMPTY_SLAB
+  };
+
+  VulkanMemoryPool(vk::Device   device,
+                   DeviceMask   deviceMask,
+                   MemTypeIndex memTypeIdx,
+                   bool         keepMapped,
+                   size_t       minPageAllocationSize = 4 << 20,
+                   SlabPolicy   slabPolicy            = SlabPolicy::KEEP_LAST_EMPTY_SLAB,
+                   PageBackend* pageBackend           = nullptr);
   ~VulkanMemoryPool();
 
-  Allocation alloc(size_t size, size_t alignment);
+  Allocation   alloc(size_t size, size_t alignment);
+  // a dedicated allocation gets its own page which is released as soon as the allocation is freed
+  Allocation   allocDedicated(size_t size, vk::MemoryDedicatedAllocateInfo const& dedicatedAllocateInfo);
+  MemTypeIndex getMemTypeIndex() const { return m_memTypeIdx; }
+
+  // compaction works by evacuating the most sparsely used page: no new allocations are placed in that page, the
+  // owners of its allocations move them elsewhere (see Allocation::isEvacuating()), and the page is released as soon
+  // as it is empty
+  // a page whose evacuation is ended before it became empty will not be chosen again
+  bool beginEvacuation(float maxPageOccupancy);
+  void endEvacuation();
+  bool isEvacuating();
+
+  // must be called once per frame
+  // pages which have been empty for at least minEmptyFrames consecutive calls are released back to the driver, but
+  // numReservedPages empty pages are kept to avoid allocating and freeing the same page over and over again
+  void releaseEmptyPages(uint32_t minEmptyFrames, uint32_t numReservedPages);
+
+  // the live bytes only include blocks of slabs which are in use, while the free blocks only refer to the pages' free
+  // intervals
+  // the allocation and free counters are reset by each call
+  Statistics collectStatistics();
 
 private:
-  vk::Device                         m_device;
-  DeviceMask                         m_deviceMask;
-  MemTypeIndex                       m_memTypeIdx;
-  bool                               m_keepMapped;
-  size_t                             m_minPageAllocationSize;
-  std::vector<struct PageAllocation> m_pageAllocations;
-  std::mutex                         m_mtx;
-
-  void free(Allocation const& alloc);
+  // small and medium sized allocations are served from slabs of equally sized blocks, one bin per power-of-two size
+  // class, so that they can be allocated and freed in constant time
+  // only allocations larger than the largest size class go through the free interval lists of the pages
+  static constexpr uint32_t MIN_SIZE_CLASS_LOG2 = 8;
+  static constexpr uint32_t MAX_SIZE_CLASS_LOG2 = 16;
+  static constexpr uint32_t NUM_SIZE_CLASSES    = MAX_SIZE_CLASS_LOG2 - MIN_SIZE_CLASS_LOG2 + 1;
+  static constexpr size_t   MIN_SLAB_SIZE       = 64 << 10;
+  static constexpr uint32_t MIN_BLOCKS_PER_SLAB = 16;
+
+  std::unique_ptr<PageBackend>                        m_devicePageBackend;
+  PageBackend*                                        m_pageBackend;
+  DeviceMask                                          m_deviceMask;
+  MemTypeIndex                                        m_memTypeIdx;
+  bool                                                m_keepMapped;
+  size_t                                              m_minPageAllocationSize;
+  SlabPolicy                                          m_slabPolicy;
+  // pages are kept behind stable pointers, so that allocations and slabs can refer to their page directly
+  std::vector<std::unique_ptr<struct PageAllocation>> m_pageAllocations;
+  std::vector<struct SizeClassBin>                    m_sizeClassBins;
+  struct PageAllocation*                              m_evacuatingPage;
+  uint32_t                                            m_numAllocs;
+  uint32_t                                            m_numFrees;
+  std::mutex                                          m_mtx;
+
+  std::optional<uint32_t> getSizeClass(size_t size, size_t alignment) const;
+  struct PageAllocation&  createPage(size_t size, vk::MemoryDedicatedAllocateInfo const* dedicatedAllocateInfo);
+  struct PageAllocation&  requestPageInterval(size_t size, size_t alignment, struct Interval& interval);
+  struct Slab*            createSlab(uint32_t sizeClass);
+  void                    destroySlab(struct Slab* slab);
+  void                    removePartialSlab(struct Slab* slab);
+  void                    releasePage(struct PageAllocation* page);
+  void                    free(Allocation const& alloc);
 };
 
 class VulkanMemoryPool::Allocation
@@ -58,17 +141,26 @@ public:
   vk::DeviceMemory devMem() const { return m_devMem; }
   size_t           devMemOffset() const { return m_devMemOffset; }
   void*            mappedMem() const { return m_mappedMem; }
+  bool             isEvacuating() const;
 
 private:
   friend class VulkanMemoryPool;
 
-  VulkanMemoryPool* m_memPool;
-  vk::DeviceMemory  m_devMem;
-  size_t            m_devMemOffset;
-  void*             m_mappedMem;
-  size_t            m_size;
+  VulkanMemoryPool*      m_memPool;
+  struct PageAllocation* m_page;
+  struct Slab*           m_slab;
+  vk::DeviceMemory       m_devMem;
+  size_t                 m_devMemOffset;
+  void*                  m_mappedMem;
+  size_t                 m_size;
 
-  Allocation(VulkanMemoryPool* memPool, vk::DeviceMemory devMem, size_t devMemOffset, void* mappedMem, size_t size);
+  Allocation(VulkanMemoryPool*      memPool,
+             struct PageAllocation* page,
+             struct Slab*           slab,
+             vk::DeviceMemory       devMem,
+             size_t                 devMemOffset,
+             void*                  mappedMem,
+             size_t                 size);
 
   void clear();
 };